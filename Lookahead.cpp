@@ -0,0 +1,143 @@
+#include "Lookahead.h"
+#include <algorithm>
+#include <climits>
+
+namespace pacman
+{
+    static constexpr int DEATH = -1000000;
+    static constexpr eDir DIRS[4] = { eDir::Up, eDir::Left, eDir::Down, eDir::Right };
+
+    static eDir opposite(eDir d)
+    {
+        return d == eDir::None ? eDir::None : static_cast<eDir>((static_cast<int>(d) + 2) % 4);
+    }
+
+    Branch::Branch(const LookaheadLevel& level, int pacman, eDir dir)
+        : _level(&level),
+          _pellets(std::make_shared<std::vector<uint64_t>>((level.nav->count() + 63) / 64, 0)),
+          _pac{static_cast<int16_t>(pacman), dir}
+    {
+    }
+
+    void Branch::addGhost(int node, eDir dir)
+    {
+        if (_ghostCount < MAX_GHOSTS)
+            _ghosts[_ghostCount++] = {static_cast<int16_t>(node), dir};
+    }
+
+    void Branch::addPellet(int node)
+    {
+        (*_pellets)[node / 64] |= 1ULL << (node % 64);
+    }
+
+    /**
+     * @brief Scores the pellets of Pac-Man's cell, unsharing the pellet set first if a fork still uses it.
+     */
+    void Branch::eat()
+    {
+        const int n = _pac.node;
+        if (!((*_pellets)[n / 64] & (1ULL << (n % 64))))
+            return;
+        if (_pellets.use_count() > 1)
+            _pellets = std::make_shared<std::vector<uint64_t>>(*_pellets);
+        (*_pellets)[n / 64] &= ~(1ULL << (n % 64));
+        _score += _level->value[n];
+    }
+
+    /**
+     * @brief Ghosts use AISystem's chase rule: never reverse unless cornered, and take the open
+     * direction closest to Pac-Man, trying the current one first. Meeting in a cell or swapping
+     * cells with Pac-Man is a death.
+     */
+    void Branch::step(eDir d)
+    {
+        if (_dead)
+            return;
+        const NavGraph& nav = *_level->nav;
+
+        const int from = _pac.node;
+        int to = nav.neighbour(from, d);
+        if (to != NavGraph::NO_NODE)
+            _pac.dir = d;
+        else
+            to = nav.neighbour(from, _pac.dir);
+        if (to != NavGraph::NO_NODE) {
+            _pac.node = static_cast<int16_t>(to);
+            eat();
+        }
+
+        for (int i = 0; i < _ghostCount; ++i) {
+            Mover& g = _ghosts[i];
+            const int at = g.node;
+            const eDir reverse = opposite(g.dir);
+
+            eDir best = eDir::None;
+            int next = at;
+            int bestDist = NavGraph::UNREACHABLE + 1;
+            for (eDir gd : {g.dir, eDir::Up, eDir::Left, eDir::Down, eDir::Right}) {
+                if (gd == eDir::None || gd == reverse)
+                    continue;
+                const int n = nav.neighbour(at, gd);
+                if (n == NavGraph::NO_NODE)
+                    continue;
+                const int dist = nav.distance(n, _pac.node);
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = gd;
+                    next = n;
+                }
+            }
+            if (best == eDir::None && nav.neighbour(at, reverse) != NavGraph::NO_NODE) {
+                best = reverse;
+                next = nav.neighbour(at, reverse);
+            }
+            g.node = static_cast<int16_t>(next);
+            if (best != eDir::None)
+                g.dir = best;
+
+            if (next == _pac.node || (next == from && at == _pac.node))
+                _dead = true;
+        }
+    }
+
+    static int search(const Branch& b, int depth, int& steps)
+    {
+        if (b.dead())
+            return DEATH - depth;
+        if (depth == 0)
+            return b.score();
+
+        int best = INT_MIN;
+        for (eDir d : DIRS) {
+            if (!b.open(d))
+                continue;
+            Branch child = b.fork();
+            child.step(d);
+            ++steps;
+            best = std::max(best, search(child, depth - 1, steps));
+        }
+        return best == INT_MIN ? b.score() : best;
+    }
+
+    eDir bestMove(const Branch& root, int depth, int* steps)
+    {
+        int count = 0;
+        int best = INT_MIN;
+        eDir move = eDir::None;
+        for (eDir d : DIRS) {
+            if (!root.open(d))
+                continue;
+            Branch child = root.fork();
+            child.step(d);
+            ++count;
+            const int value = search(child, depth - 1, count);
+            if (value > best) {
+                best = value;
+                move = d;
+            }
+        }
+        if (steps != nullptr)
+            *steps = count;
+        return move;
+    }
+} // namespace pacman
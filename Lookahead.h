@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "NavGraph.h"
+/**
+ * @file Lookahead.h
+ * @brief Physics-free model of the game for bots that search future branches.
+ *
+ * A branch moves Pac-Man and the ghosts one navigation cell per step over the NavGraph, the ghosts
+ * chasing the way AISystem does. Static level data (graph, pellet values) is shared by pointer, and the
+ * set of remaining pellets is shared between a branch and all of its forks until one of them eats a
+ * pellet, which copies it (copy on write). A fork is a copy of a few dozen bytes.
+ */
+
+namespace pacman {
+
+    /**
+     * @brief Per-level data shared by every branch.
+     */
+    struct LookaheadLevel {
+        const NavGraph* nav = nullptr;
+        std::vector<uint16_t> value;     ///< per node: score of the pellets whose center lies in its cell
+    };
+
+    class Branch {
+    public:
+        static constexpr int MAX_GHOSTS = 4;
+
+        Branch(const LookaheadLevel& level, int pacman, eDir dir);
+
+        void addGhost(int node, eDir dir);
+        /// marks the pellets of a node as still on the board; only valid before the first fork
+        void addPellet(int node);
+
+        /// independent continuation of this branch; pellets stay shared until either side eats one
+        Branch fork() const { return *this; }
+
+        /// advances one cell: Pac-Man turns toward d if open (else keeps going), then every ghost moves
+        void step(eDir d);
+        /// true if Pac-Man can leave its cell in direction d
+        bool open(eDir d) const { return _level->nav->neighbour(_pac.node, d) != NavGraph::NO_NODE; }
+
+        bool dead() const { return _dead; }
+        int score() const { return _score; }
+        int pacman() const { return _pac.node; }
+    private:
+        struct Mover {
+            int16_t node;
+            eDir dir;
+        };
+
+        void eat();
+
+        const LookaheadLevel* _level;
+        std::shared_ptr<std::vector<uint64_t>> _pellets;   ///< bit per node, set while its pellets remain
+        Mover _pac;
+        Mover _ghosts[MAX_GHOSTS] = {};
+        int _ghostCount = 0;
+        int _score = 0;
+        bool _dead = false;
+    };
+
+    /**
+     * @brief Exhaustive depth-first search over Pac-Man's moves.
+     * @param root Branch to search from; it is only forked, never modified.
+     * @param depth Number of steps to look ahead.
+     * @param steps If not null, receives the number of branch steps simulated.
+     * @return First move of the best branch: highest score, and among dying branches the latest death.
+     */
+    eDir bestMove(const Branch& root, int depth, int* steps = nullptr);
+} // namespace pacman
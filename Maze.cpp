@@ -0,0 +1,74 @@
+#include "Maze.h"
+#include <algorithm>
+#include <cmath>
+
+namespace pacman
+{
+    /**
+     * @brief Creates an empty grid.
+     * @param width Number of columns (pixels).
+     * @param height Number of rows (pixels).
+     */
+    Maze::Maze(int width, int height)
+        : _width(width), _height(height), _stride((width + WORD_BITS - 1) / WORD_BITS),
+          _bits(static_cast<size_t>(_stride) * height, 0)
+    {
+    }
+
+    /**
+     * @brief Computes the half-open cell range [x0,x1) x [y0,y1) whose centers lie inside r.
+     * @return False if the range is empty.
+     */
+    bool Maze::cells(const SDL_FRect& r, int& x0, int& y0, int& x1, int& y1) const
+    {
+        x0 = std::max(0, static_cast<int>(std::ceil(r.x - 0.5f)));
+        y0 = std::max(0, static_cast<int>(std::ceil(r.y - 0.5f)));
+        x1 = std::min(_width, static_cast<int>(std::ceil(r.x + r.w - 0.5f)));
+        y1 = std::min(_height, static_cast<int>(std::ceil(r.y + r.h - 0.5f)));
+        return x0 < x1 && y0 < y1;
+    }
+
+    void Maze::fill(const SDL_FRect& r)
+    {
+        int x0, y0, x1, y1;
+        if (!cells(r, x0, y0, x1, y1))
+            return;
+        for (int y = y0; y < y1; ++y)
+            for (int x = x0; x < x1; ++x)
+                _bits[y*_stride + x/WORD_BITS] |= uint64_t{1} << (x % WORD_BITS);
+    }
+
+    /**
+     * @brief Tests a rectangle word by word; the cost is proportional to the rows and words it touches.
+     */
+    bool Maze::anyBlocked(const SDL_FRect& r) const
+    {
+        int x0, y0, x1, y1;
+        if (!cells(r, x0, y0, x1, y1))
+            return false;
+
+        const int w0 = x0 / WORD_BITS;
+        const int w1 = (x1 - 1) / WORD_BITS;
+        const uint64_t first = ~uint64_t{0} << (x0 % WORD_BITS);
+        const uint64_t last = ~uint64_t{0} >> (WORD_BITS - 1 - (x1 - 1) % WORD_BITS);
+
+        for (int y = y0; y < y1; ++y) {
+            const uint64_t* row = &_bits[y*_stride];
+            for (int w = w0; w <= w1; ++w) {
+                uint64_t m = ~uint64_t{0};
+                if (w == w0) m &= first;
+                if (w == w1) m &= last;
+                if (row[w] & m)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    bool Maze::blocked(int x, int y) const
+    {
+        if (x < 0 || y < 0 || x >= _width || y >= _height)
+            return true;
+        return (_bits[y*_stride + x/WORD_BITS] >> (x % WORD_BITS)) & 1;
+    }
+} // namespace pacman
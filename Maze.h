@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <SDL3/SDL.h>
+/**
+ * @file Maze.h
+ * @brief Bit-packed occupancy grid of the maze walls.
+ *
+ * Every cell covers one window pixel and is stored as a single bit, one row of 64-bit words per line,
+ * so a query touches only the words that cover the queried rectangle.
+ */
+
+namespace pacman {
+
+    class Maze {
+    public:
+        Maze(int width, int height);
+
+        /// marks every cell whose center lies inside r as a wall
+        void fill(const SDL_FRect& r);
+        /// true if any cell whose center lies inside r is a wall
+        bool anyBlocked(const SDL_FRect& r) const;
+        /// true if the cell (x,y) is a wall; cells outside the grid count as walls
+        bool blocked(int x, int y) const;
+
+        int width() const { return _width; }
+        int height() const { return _height; }
+    private:
+        bool cells(const SDL_FRect& r, int& x0, int& y0, int& x1, int& y1) const;
+
+        static constexpr int WORD_BITS = 64;
+
+        int _width;
+        int _height;
+        int _stride;
+        std::vector<uint64_t> _bits;
+    };
+} // namespace pacman
@@ -0,0 +1,135 @@
+#include "NavGraph.h"
+#include <algorithm>
+#include <cmath>
+
+namespace pacman
+{
+    static constexpr int DX[4] = { 0, -1, 0, 1 };
+    static constexpr int DY[4] = { -1, 0, 1, 0 };
+
+    /**
+     * @brief Samples the free space of the probe, links the cells it connects and fills the all-pairs tables.
+     *
+     * The tables are filled by one breadth-first search per node, O(N^2) time and memory; this runs once per level.
+     */
+    void NavGraph::build(const Maze& maze, SDL_FPoint probe, float cell, float sample)
+    {
+        _cell = cell;
+        _cols = static_cast<int>(std::ceil(maze.width() / cell));
+        _rows = static_cast<int>(std::ceil(maze.height() / cell));
+        const int cells = _cols * _rows;
+
+        // free-space samples: where the probe's center may be without touching a wall
+        const int sw = static_cast<int>(maze.width() / sample);
+        const int sh = static_cast<int>(maze.height() / sample);
+        std::vector<uint8_t> freeAt(sw * sh);
+        std::vector<int> cellAt(sw * sh);
+        for (int sy = 0; sy < sh; ++sy) {
+            for (int sx = 0; sx < sw; ++sx) {
+                const float x = (sx + 0.5f) * sample;
+                const float y = (sy + 0.5f) * sample;
+                freeAt[sy*sw + sx] = !maze.anyBlocked({x - probe.x/2, y - probe.y/2, probe.x, probe.y});
+                cellAt[sy*sw + sx] = static_cast<int>(y / cell) * _cols + static_cast<int>(x / cell);
+            }
+        }
+
+        // a cell is open if it holds a free sample; neighbouring free samples in different cells link them
+        std::vector<uint8_t> open(cells, 0);
+        std::vector<uint8_t> cellLinks(cells, 0);
+        for (int sy = 0; sy < sh; ++sy) {
+            for (int sx = 0; sx < sw; ++sx) {
+                const int s = sy*sw + sx;
+                if (!freeAt[s])
+                    continue;
+                open[cellAt[s]] = 1;
+                if (sx+1 < sw && freeAt[s+1] && cellAt[s+1] != cellAt[s]) {
+                    cellLinks[cellAt[s]] |= 1 << static_cast<int>(eDir::Right);
+                    cellLinks[cellAt[s+1]] |= 1 << static_cast<int>(eDir::Left);
+                }
+                if (sy+1 < sh && freeAt[s+sw] && cellAt[s+sw] != cellAt[s]) {
+                    cellLinks[cellAt[s]] |= 1 << static_cast<int>(eDir::Down);
+                    cellLinks[cellAt[s+sw]] |= 1 << static_cast<int>(eDir::Up);
+                }
+            }
+        }
+
+        _nearest.assign(cells, NO_NODE);
+        _cellOf.clear();
+        _links.clear();
+        for (int c = 0; c < cells; ++c) {
+            if (open[c]) {
+                _nearest[c] = static_cast<int16_t>(_cellOf.size());
+                _cellOf.push_back(static_cast<int16_t>(c));
+                _links.push_back(cellLinks[c]);
+            }
+        }
+        _count = static_cast<int>(_cellOf.size());
+
+        // blocked cells borrow the closest open cell's node (multi-source BFS over the cell grid)
+        std::vector<int> queue(std::max(cells, _count));
+        int head = 0, tail = 0;
+        for (int n = 0; n < _count; ++n)
+            queue[tail++] = _cellOf[n];
+        while (head < tail) {
+            const int c = queue[head++];
+            const int cx = c % _cols, cy = c / _cols;
+            for (int d = 0; d < 4; ++d) {
+                const int nx = cx + DX[d], ny = cy + DY[d];
+                if (nx < 0 || ny < 0 || nx >= _cols || ny >= _rows || _nearest[ny*_cols + nx] != NO_NODE)
+                    continue;
+                _nearest[ny*_cols + nx] = _nearest[c];
+                queue[tail++] = ny*_cols + nx;
+            }
+        }
+
+        _dist.assign(static_cast<size_t>(_count) * _count, UNREACHABLE);
+        _next.assign(static_cast<size_t>(_count) * _count, static_cast<uint8_t>(eDir::None));
+        for (int s = 0; s < _count; ++s) {
+            uint8_t* dist = &_dist[static_cast<size_t>(s) * _count];
+            uint8_t* next = &_next[static_cast<size_t>(s) * _count];
+            dist[s] = 0;
+            head = tail = 0;
+            queue[tail++] = s;
+            while (head < tail) {
+                const int u = queue[head++];
+                for (int d = 0; d < 4; ++d) {
+                    const int v = neighbour(u, static_cast<eDir>(d));
+                    if (v == NO_NODE || dist[v] != UNREACHABLE)
+                        continue;
+                    dist[v] = static_cast<uint8_t>(std::min(dist[u] + 1, UNREACHABLE - 1));
+                    next[v] = u == s ? static_cast<uint8_t>(d) : next[u];
+                    queue[tail++] = v;
+                }
+            }
+        }
+    }
+
+    int NavGraph::node(SDL_FPoint p) const
+    {
+        const int cx = std::clamp(static_cast<int>(p.x / _cell), 0, _cols - 1);
+        const int cy = std::clamp(static_cast<int>(p.y / _cell), 0, _rows - 1);
+        return _nearest[cy*_cols + cx];
+    }
+
+    int NavGraph::neighbour(int a, eDir d) const
+    {
+        if (d == eDir::None || !(_links[a] & (1 << static_cast<int>(d))))
+            return NO_NODE;
+        const int c = _cellOf[a];
+        const int i = static_cast<int>(d);
+        return _nearest[(c / _cols + DY[i]) * _cols + c % _cols + DX[i]];
+    }
+
+    /**
+     * @brief Points the field at the target's row of the all-pairs table; nothing is copied.
+     */
+    bool FlowField::retarget(const NavGraph& nav, int target)
+    {
+        const uint8_t* row = nav.distances(target);
+        if (target == _target && row == _row)
+            return false;
+        _target = target;
+        _row = row;
+        return true;
+    }
+} // namespace pacman
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <SDL3/SDL.h>
+#include "Maze.h"
+/**
+ * @file NavGraph.h
+ * @brief Precomputed ghost navigation over the maze.
+ *
+ * The board is split into square cells. A cell is a node if a ghost-sized box fits somewhere inside it,
+ * and two nodes are linked if a ghost can slide from one into the other. Shortest distances and the first
+ * move between every pair of nodes are stored in flat N*N tables, so a ghost decision is a table lookup.
+ */
+
+namespace pacman {
+
+    /**
+     * @brief Movement directions, in the tie-break order of the arcade ghosts.
+     */
+    enum class eDir : uint8_t { Up, Left, Down, Right, None };
+
+    class NavGraph {
+    public:
+        static constexpr int NO_NODE = -1;
+        static constexpr uint8_t UNREACHABLE = 0xFF;
+
+        /**
+         * @brief Builds the graph and its all-pairs tables.
+         * @param maze Wall occupancy grid.
+         * @param probe Size (pixels) of the body that moves through the maze.
+         * @param cell Side (pixels) of a navigation cell.
+         * @param sample Spacing (pixels) of the free-space samples taken inside each cell.
+         */
+        void build(const Maze& maze, SDL_FPoint probe, float cell, float sample);
+
+        /// node of the cell containing p, or the nearest node if that cell is blocked
+        int node(SDL_FPoint p) const;
+        /// node reached by leaving a in direction d, or NO_NODE if they are not linked
+        int neighbour(int a, eDir d) const;
+        /// shortest distance from a to b in cells (UNREACHABLE if disconnected)
+        uint8_t distance(int a, int b) const { return _dist[a*_count + b]; }
+        /// distances from a to every node; links go both ways, so this is also every node's distance to a
+        const uint8_t* distances(int a) const { return &_dist[static_cast<size_t>(a) * _count]; }
+        /// first move on a shortest path from a to b (None if a == b or disconnected)
+        eDir nextHop(int a, int b) const { return static_cast<eDir>(_next[a*_count + b]); }
+
+        int count() const { return _count; }
+        int cols() const { return _cols; }
+        int rows() const { return _rows; }
+        float cellSize() const { return _cell; }
+        /// cell index (row-major) of node a
+        int cell(int a) const { return _cellOf[a]; }
+    private:
+        int _cols = 0;
+        int _rows = 0;
+        float _cell = 1;
+        int _count = 0;
+
+        std::vector<int16_t> _nearest;   ///< per cell: its node, or the closest node for blocked cells
+        std::vector<int16_t> _cellOf;    ///< per node: cell index
+        std::vector<uint8_t> _links;     ///< per node: bit d set if linked in direction d
+        std::vector<uint8_t> _dist;      ///< N*N shortest distances
+        std::vector<uint8_t> _next;      ///< N*N first moves
+    };
+
+    /**
+     * @brief Distance field toward one shared target: the target's row of the all-pairs table.
+     *
+     * Every chasing ghost reads its neighbours from this one contiguous row instead of striding
+     * through the N*N table column by column.
+     */
+    class FlowField {
+    public:
+        /**
+         * @brief Points the field at target; a no-op while the target stays in the same node.
+         * @return True if the field was refreshed.
+         */
+        bool retarget(const NavGraph& nav, int target);
+
+        /// distance from node a to the current target
+        uint8_t distance(int a) const { return _row[a]; }
+        int target() const { return _target; }
+    private:
+        int _target = NavGraph::NO_NODE;
+        const uint8_t* _row = nullptr;
+    };
+} // namespace pacman
@@ -1,10 +1,15 @@
 #include "Pacman.h"
 #include <iostream>
+#include <cstring>
 #include <SDL3/SDL.h>
 #include <SDL3_image/SDL_image.h>
 #include <box2d/box2d.h>
 
 #include "lib/box2d/src/body.h"
+extern "C" {
+#include "lib/box2d/src/world.h"
+#include "lib/box2d/src/arena_allocator.h"
+}
 
 
 
@@ -12,129 +17,235 @@ using namespace std;
 #include "bagel.h"
 using namespace bagel;
 
+/// every component type of the game, for operations on the whole world
+#define PACMAN_COMPONENTS Position, Drawable, Collider, Intent, Input, \
+    Pellet, PlayerStats, PlayerControlled, Ghost, Wall, Background
+
 namespace pacman
 {
+    /**
+     * @brief Destroys a body together with the entity handle stored in its user data.
+     */
+    static void destroyBody(b2BodyId b)
+    {
+        delete static_cast<ent_type*>(b2Body_GetUserData(b));
+        b2DestroyBody(b);
+    }
+
+    /**
+     * @brief Box2D state saved per Collider entity in a snapshot.
+     */
+    struct BodyState {
+        b2Transform t;
+        b2Vec2 v;
+    };
+
     /**
      * @brief Checks whether the Pac-Man texture was successfully loaded.
      * @return True if the texture is valid (not null), false otherwise.
      */
     bool PacMan::valid()
     {
-        return tex != nullptr;
+        return headless || tex != nullptr;
+    }
+
+    /**
+     * @brief Points an intent toward d and clears its blocked flags.
+     */
+    static void steer(Intent& in, eDir d)
+    {
+        in.up = d == eDir::Up;
+        in.left = d == eDir::Left;
+        in.down = d == eDir::Down;
+        in.right = d == eDir::Right;
+        in.blockedUp = in.blockedDown = in.blockedLeft = in.blockedRight = false;
     }
 
     /**
     * @brief Processes keyboard input for player-controlled entities and sets movement intentions.
+    *
+    * Every change it makes is appended to the active recording, if any.
     */
     void PacMan::InputSystem() {
-        Mask required = MaskBuilder()
-                .set<Input>()
-                .set<Intent>()
-                .set<PlayerControlled>()
-                .build();
-
         SDL_PumpEvents();
         const bool* keys = SDL_GetKeyboardState(nullptr);
-        for (id_type id = 0; id <= World::maxId().id; ++id) {
-            ent_type e{id};
-            if (World::mask(e).test(required)) {
-                const auto& k = World::getComponent<Input>(e);
-                auto& in = World::getComponent<Intent>(e);
-                if (keys[k.up] && !in.blockedUp) {
-                    in.up = true;
-                    in.down = in.left = in.right = false;
-                    in.blockedUp = in.blockedDown = in.blockedLeft = in.blockedRight = false;
-                }
-                else if (keys[k.down] && !in.blockedDown) {
-                    in.down = true;
-                    in.up = in.left = in.right = false;
-                    in.blockedUp = in.blockedDown = in.blockedLeft = in.blockedRight = false;
-                }
-                else if (keys[k.left] && !in.blockedLeft) {
-                    in.left = true;
-                    in.up = in.down = in.right = false;
-                    in.blockedUp = in.blockedDown = in.blockedLeft = in.blockedRight = false;
-                }
-                else if (keys[k.right] && !in.blockedRight) {
-                    in.right = true;
-                    in.up = in.down = in.left = false;
-                    in.blockedUp = in.blockedDown = in.blockedLeft = in.blockedRight = false;
-                }
-            }
-        }
+        World::each<Input, Intent, PlayerControlled>([this, keys](ent_type e) {
+            const auto& k = World::getComponent<Input>(e);
+            auto& in = World::getComponent<Intent>(e);
+            eDir d = eDir::None;
+            if (keys[k.up] && !in.blockedUp)
+                d = eDir::Up;
+            else if (keys[k.down] && !in.blockedDown)
+                d = eDir::Down;
+            else if (keys[k.left] && !in.blockedLeft)
+                d = eDir::Left;
+            else if (keys[k.right] && !in.blockedRight)
+                d = eDir::Right;
+            if (d == eDir::None)
+                return;
+
+            Intent next = in;
+            steer(next, d);
+            if (recording != nullptr && memcmp(&next, &in, sizeof(Intent)) != 0)
+                recording->push(tick, d);
+            in = next;
+        });
+    }
+
+    /**
+    * @brief Replaces InputSystem during replays: applies the changes recorded for the current tick.
+    */
+    void PacMan::ReplaySystem(InputRecording::Reader& reader) {
+        eDir d;
+        while (reader.poll(tick, d))
+            steerPlayers(d);
+    }
+
+    /**
+    * @brief Points every player-controlled entity toward d.
+    */
+    void PacMan::steerPlayers(eDir d) {
+        World::each<PlayerControlled, Intent>([d](ent_type e) {
+            steer(World::getComponent<Intent>(e), d);
+        });
     }
 
     /**
      * @brief Applies movement to entities based on their current intent and updates Box2D body velocities.
+     *
+     * The intended step is checked against the maze grid first and a blocked move is refused
+     * before it happens; AISystem picks a new direction for blocked ghosts on the next frame.
+     * Movers are iterated as a group, without going through the entity masks.
      */
     void PacMan::MovementSystem()
     {
-        static const Mask mask = MaskBuilder()
-            .set<Intent>()
-            .set<Collider>()
-            .set<Position>()
-            .build();
+        Movers::each([this](ent_type e, Intent& i, const Collider& c) {
+            bool isPlayer = World::mask(e).test(Component<PlayerControlled>::Bit);
+
+            const float y = i.up ? -MOVE_SPEED : i.down ? MOVE_SPEED : 0;
+            const float x = i.left ? -MOVE_SPEED : i.right ? MOVE_SPEED : 0;
+
+            if ((x != 0 || y != 0) && wallAhead(c.b, {x*BOX2D_STEP, y*BOX2D_STEP})) {
+                //pacman or ghost is about to hit a wall
+                if (i.up || i.down) {
+                    i.blockedUp = i.up;
+                    i.blockedDown = i.down;
+                    i.up = i.down = false;
+                }
+                else {
+                    i.blockedLeft = i.left;
+                    i.blockedRight = i.right;
+                    i.left = i.right = false;
+                }
+                b2Body_SetLinearVelocity(c.b, {0,0});
+                return;
+            }
 
-        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
-            if (World::mask(e).test(mask)) {
-                auto& i = World::getComponent<Intent>(e);
-                const auto& c = World::getComponent<Collider>(e);
-                bool isPlayer = World::mask(e).test(Component<PlayerControlled>::Bit);
-                bool isGhost = World::mask(e).test(Component<Ghost>::Bit);
-
-                const float y = i.up ? -20 : i.down ? 20 : 0;
-                const float x = i.left ? -20 : i.right ? 20 : 0;
-
-                b2Body_SetLinearVelocity(c.b, {x,y});
-                if (isPlayer) {
-                    if (i.up) {
-                        b2Body_SetTransform(c.b, b2Body_GetPosition(c.b), {0.0f, -1.0f});
-                        i.blockedDown = i.blockedLeft = i.blockedRight = false;
-                    }else if (i.down) {
-                        b2Body_SetTransform(c.b, b2Body_GetPosition(c.b), {0.0f, 1.0f});
-                        i.blockedUp = i.blockedLeft = i.blockedRight = false;
-                    } else if (i.left) {
-                        b2Body_SetTransform(c.b, b2Body_GetPosition(c.b), {-1.0f, 0.0f});
-                        i.blockedUp = i.blockedDown = i.blockedRight = false;
-                    }else if (i.right) {
-                        b2Body_SetTransform(c.b, b2Body_GetPosition(c.b), {1.0f, 0.0f});
-                        i.blockedUp = i.blockedDown = i.blockedLeft = false;
-                    }
+            b2Body_SetLinearVelocity(c.b, {x,y});
+            if (isPlayer) {
+                if (i.up) {
+                    b2Body_SetTransform(c.b, b2Body_GetPosition(c.b), {0.0f, -1.0f});
+                    i.blockedDown = i.blockedLeft = i.blockedRight = false;
+                }else if (i.down) {
+                    b2Body_SetTransform(c.b, b2Body_GetPosition(c.b), {0.0f, 1.0f});
+                    i.blockedUp = i.blockedLeft = i.blockedRight = false;
+                } else if (i.left) {
+                    b2Body_SetTransform(c.b, b2Body_GetPosition(c.b), {-1.0f, 0.0f});
+                    i.blockedUp = i.blockedDown = i.blockedRight = false;
+                }else if (i.right) {
+                    b2Body_SetTransform(c.b, b2Body_GetPosition(c.b), {1.0f, 0.0f});
+                    i.blockedUp = i.blockedDown = i.blockedLeft = false;
                 }
             }
+        });
+    }
+
+    /**
+     * @brief Checks whether moving a body by the given translation would hit a wall.
+     *
+     * Only the strip swept by the body's leading edge is looked up in the maze grid,
+     * narrowed by WALL_SKIN on the sides so walls grazed from the side never block.
+     * @param b The body to move.
+     * @param translation Intended displacement for this step, in Box2D units.
+     * @return True if a wall blocks the move.
+     */
+    bool PacMan::wallAhead(b2BodyId b, b2Vec2 translation) const
+    {
+        const b2AABB box = b2Body_ComputeAABB(b);
+        const SDL_FRect r = {
+            box.lowerBound.x*BOX_SCALE, box.lowerBound.y*BOX_SCALE,
+            (box.upperBound.x-box.lowerBound.x)*BOX_SCALE, (box.upperBound.y-box.lowerBound.y)*BOX_SCALE};
+        const float dx = translation.x*BOX_SCALE;
+        const float dy = translation.y*BOX_SCALE;
+
+        SDL_FRect ahead;
+        if (dx != 0)
+            ahead = {dx > 0 ? r.x+r.w : r.x+dx, r.y+WALL_SKIN, SDL_fabsf(dx), r.h-2*WALL_SKIN};
+        else
+            ahead = {r.x+WALL_SKIN, dy > 0 ? r.y+r.h : r.y+dy, r.w-2*WALL_SKIN, SDL_fabsf(dy)};
+        return maze.anyBlocked(ahead);
+    }
+
+    /**
+     * @brief Checks whether a body could take one movement step in the given direction.
+     */
+    bool PacMan::canMove(b2BodyId b, eDir d) const
+    {
+        constexpr float STEP = MOVE_SPEED * BOX2D_STEP;
+        switch (d) {
+            case eDir::Up:    return !wallAhead(b, {0, -STEP});
+            case eDir::Left:  return !wallAhead(b, {-STEP, 0});
+            case eDir::Down:  return !wallAhead(b, {0, STEP});
+            case eDir::Right: return !wallAhead(b, {STEP, 0});
+            default:          return false;
         }
     }
 
+    /**
+     * @brief Navigation node under a body's center.
+     */
+    int PacMan::nodeOf(b2BodyId b) const
+    {
+        const b2Vec2 p = b2Body_GetPosition(b);
+        return nav.node({p.x*BOX_SCALE, p.y*BOX_SCALE});
+    }
+
     /**
      * @brief Renders all drawable entities with textures and positions.
      */
     void PacMan::RenderSystem() {
-        static const Mask mask = MaskBuilder()
+        static constexpr Mask mask = MaskBuilder()
                 .set<Position>()
                 .set<Drawable>()
                 .build();
 
+        // animation counters of Pac-Man and the ghosts, walked without touching the sprite rects
+        using Drawables = SplitStorage<Drawable>;
+        auto& frames = Drawables::columns().frame;
+        for (index_type i = 0; i < Drawables::size(); ++i) {
+            const Mask& m = World::mask(Drawables::entity(i));
+            if (m.test(Component<PlayerControlled>::Bit) || m.test(Component<Ghost>::Bit)) {
+                frames[i]++;
+                if (frames[i] == 100)
+                    frames[i] = 0;
+            }
+        }
+
         SDL_RenderClear(ren);
         for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
             if (World::mask(e).test(mask)) {
-                const auto& t = World::getComponent<Position>(e);
-                auto& d = World::getComponent<Drawable>(e);
+                const auto& t = World::readComponent<Position>(e);
+                const auto d = World::readComponent<Drawable>(e);
                 bool pacman = World::mask(e).test(Component<PlayerControlled>::Bit);
-                bool ghost = World::mask(e).test(Component<Ghost>::Bit);
-
-                if (pacman || ghost) {
-                    d.frame++;
-                    if (d.frame == 100)
-                        d.frame = 0;
-                    if (pacman) {
-                        auto& stat = World::getComponent<PlayerStats>(e);
-                        for (int i = 0 ; i < stat.lives; ++i) {
-                            float space = 5.f + (float) i*CLOSE_PACMAN.w;
-                            SDL_FRect lives = {(space)*CHARACTER_TEX_SCALE, (BOARD.h + 4.f) * CHARACTER_TEX_SCALE, CLOSE_PACMAN.w*CHARACTER_TEX_SCALE, CLOSE_PACMAN.h*CHARACTER_TEX_SCALE};
-                            SDL_RenderTextureRotated(
-                                ren, tex, &CLOSE_PACMAN, &lives, 0,
-                                nullptr, SDL_FLIP_NONE);
-                        }
+
+                if (pacman) {
+                    auto& stat = World::getComponent<PlayerStats>(e);
+                    for (int i = 0 ; i < stat.lives; ++i) {
+                        float space = 5.f + (float) i*CLOSE_PACMAN.w;
+                        SDL_FRect lives = {(space)*CHARACTER_TEX_SCALE, (BOARD.h + 4.f) * CHARACTER_TEX_SCALE, CLOSE_PACMAN.w*CHARACTER_TEX_SCALE, CLOSE_PACMAN.h*CHARACTER_TEX_SCALE};
+                        SDL_RenderTextureRotated(
+                            ren, tex, &CLOSE_PACMAN, &lives, 0,
+                            nullptr, SDL_FLIP_NONE);
                     }
                 }
                 const SDL_FRect dst = {
@@ -152,30 +263,35 @@ namespace pacman
     }
 
     /**
-    * @brief Synchronizes Box2D world step and updates entity positions and angles from physics bodies.
+    * @brief Steps the Box2D world and copies the transforms of the bodies that moved into Position.
+    *
+    * Only Box2D's move events are visited, so static and resting bodies cost nothing.
     */
     void PacMan::box_system()
     {
-        static const Mask mask = MaskBuilder()
-            .set<Collider>()
+        static constexpr Mask mask = MaskBuilder()
             .set<Position>()
             .build();
-        static constexpr float	BOX2D_STEP = 1.f/FPS;
         b2World_Step(boxWorld, BOX2D_STEP, 4);
 
-        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
+        const b2BodyEvents be = b2World_GetBodyEvents(boxWorld);
+        for (int i = 0; i < be.moveCount; ++i) {
+            const b2BodyMoveEvent& m = be.moveEvents[i];
+            const ent_type e = *static_cast<ent_type*>(m.userData);
             if (World::mask(e).test(mask)) {
-                b2Transform t = b2Body_GetTransform(World::getComponent<Collider>(e).b);
                 World::getComponent<Position>(e) = {
-                    {t.p.x*BOX_SCALE, t.p.y*BOX_SCALE},
-                    RAD_TO_DEG * b2Rot_GetAngle(t.q)
+                    {m.transform.p.x*BOX_SCALE, m.transform.p.y*BOX_SCALE},
+                    RAD_TO_DEG * b2Rot_GetAngle(m.transform.q)
                 };
             }
         }
     }
 
     /**
-  * @brief Handles collision events between Pac-Man, ghosts, pellets, and walls.
+  * @brief Handles collision events between Pac-Man, ghosts and pellets.
+  *
+  * Entities and bodies are removed and respawned through the command buffer, flushed once the event
+  * array has been walked, so no event ever refers to a shape destroyed by an earlier one.
   */
     void PacMan::CollisionSystem()
     {
@@ -187,73 +303,9 @@ namespace pacman
             auto *e1 = static_cast<ent_type*>(b2Body_GetUserData(sensor));
 
             bool sensorIsPlayer = World::mask(*e1).test(Component<PlayerControlled>::Bit);
-            bool sensorIsWall = World::mask(*e1).test(Component<Wall>::Bit);
 
-            bool isPlayer = World::mask(*e).test(Component<PlayerControlled>::Bit);
             bool isGhost = World::mask(*e).test(Component<Ghost>::Bit);
             bool isPellet = World::mask(*e).test(Component<Pellet>::Bit);
-            bool isWall = World::mask(*e).test(Component<Wall>::Bit);
-
-            if (isWall && sensorIsWall) {
-                continue;
-            }
-            if (sensorIsWall || (isWall && sensorIsPlayer)) {
-                //pacman or ghost hit wall
-                ent_type player = sensorIsPlayer ? *e1 : *e;
-                auto& dir = World::getComponent<Intent>(player);
-                const auto& col = World::getComponent<Collider>(player);
-                auto& dGhost = World::getComponent<Drawable>(player);
-                b2Vec2 pos = b2Body_GetPosition(col.b);
-
-                b2Transform t = b2Body_GetTransform(col.b);
-                float angleC = t.q.c;
-                float angleS = t.q.s;
-
-                if (dir.up) {
-                    dir.blockedUp = true;
-                    dir.up = false;
-                    ///move pacman slightly to prevent next collision
-                    pos.y += 5.0f / BOX_SCALE;
-                    b2Body_SetTransform(col.b, pos, {angleC, angleS});
-                    if (isGhost) {
-                        dir.right = dGhost.frame % 2 == 0;
-                        dir.left = dGhost.frame % 2 != 0;
-                    }
-                }
-                else if (dir.down) {
-                    dir.blockedDown = true;
-                    dir.down = false;
-                    ///move pacman slightly to prevent next collision
-                    pos.y -= 5.0f / BOX_SCALE;
-                    b2Body_SetTransform(col.b, pos, {angleC, angleS});
-                    if (isGhost){
-                        dir.right = dGhost.frame % 2 == 0;
-                        dir.left = dGhost.frame % 2 != 0;
-                    }
-                }
-                else if (dir.left) {
-                    dir.blockedLeft = true;
-                    dir.left = false;
-                    ///move pacman slightly to prevent next collision
-                    pos.x += 5.0f / BOX_SCALE;
-                    b2Body_SetTransform(col.b, pos, {angleC, angleS});
-                    if (isGhost){
-                        dir.up = dGhost.frame % 2 == 0;
-                        dir.down = dGhost.frame % 2 != 0;
-                    }
-                }
-                else if (dir.right) {
-                    dir.blockedRight = true;
-                    dir.right = false;
-                    ///move pacman slightly to prevent next collision
-                    pos.x -= 5.0f / BOX_SCALE;
-                    b2Body_SetTransform(col.b, pos, {angleC, angleS});
-                    if (isGhost) {
-                        dir.up = dGhost.frame % 2 == 0;
-                        dir.down = dGhost.frame % 2 != 0;
-                    }
-                }
-            }
 
             if (sensorIsPlayer && isGhost) {
                 //pacman hit ghost
@@ -262,19 +314,22 @@ namespace pacman
                 if (lives == 0) {
                     //GAME-OVER
                     EndGameSystem();
-                    return;
+                    break;
 
                 }
-                auto& dGhost = World::getComponent<Drawable>(*e);
-
-                createGhost(dGhost.part[0], dGhost.part[1], {100.f*CHARACTER_TEX_SCALE, 120.f*CHARACTER_TEX_SCALE});
-                World::destroyEntity(*e1);
-                World::destroyEntity(*e);
-                b2DestroyBody(sensor);
-                b2DestroyBody(b);
-                createPacMan(lives);
+                const auto& dGhost = World::getComponent<Drawable>(*e);
+                const SDL_FRect r1 = dGhost.part[0], r2 = dGhost.part[1];
+                const int corner = World::getComponent<Ghost>(*e).corner;
+
+                commands.defer([this, r1, r2, corner] {
+                    createGhost(r1, r2, {100.f*CHARACTER_TEX_SCALE, 120.f*CHARACTER_TEX_SCALE}, corner);
+                });
+                commands.destroy(*e1);
+                commands.destroy(*e);
+                commands.defer([this, lives] { createPacMan(lives); });
                 std::cout << "Player hit by ghost! Lives left: " << lives << "\n";
-
+                // the remaining events all belong to the Pac-Man that just died
+                break;
             }
 
             if (sensorIsPlayer && isPellet) {
@@ -288,70 +343,105 @@ namespace pacman
                     stats.score += 50;
                     // TODO: Set ghosts to vulnerable state (if implemented)
                 }
-                World::destroyEntity(*e);
-                b2DestroyBody(b);
+                commands.destroy(*e);
 
             }
         }
+        commands.flush();
     }
 
     /**
-   * @brief Handles ghost AI behavior such as random movement decisions.
+   * @brief Steers ghosts toward their target using the precomputed navigation tables.
+   *
+   * Ghosts alternate between scatter (each heads for its own corner) and chase (all head for Pac-Man).
+   * Like the arcade ghosts they never reverse unless cornered. Scattering ghosts take the next hop toward
+   * their corner when it is open; otherwise, and always while chasing, the open direction with the smallest
+   * distance wins, a tie going to a direction drawn from the world's Rng. Chasers share one flow field
+   * that is only refreshed when Pac-Man changes cell.
    */
     void PacMan::AISystem() {
-        Mask required = MaskBuilder()
-        .set<Ghost>()
-        .set<Intent>()
-        .set<Drawable>()
-        .build();
+        static constexpr Mask player = MaskBuilder()
+            .set<PlayerControlled>()
+            .set<Position>()
+            .build();
 
-        for (id_type id = 0; id <= World::maxId().id; ++id) {
-            ent_type e{id};
-            if (World::mask(e).test(required)) {
-                auto& in = World::getComponent<Intent>(e);
-                auto& dr = World::getComponent<Drawable>(e);
-                if (dr.frame % 240 == 0) {
-                    in.up = in.down = in.left = in.right = false;
-                    int dir = rand() % 4;
-                    switch (dir) {
-                        case 0: in.up = true; break;
-                        case 1: in.down = true; break;
-                        case 2: in.left = true; break;
-                        case 3: in.right = true; break;
+        int chase = NavGraph::NO_NODE;
+        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
+            if (World::mask(e).test(player)) {
+                chase = nav.node(World::readComponent<Position>(e).p);
+                break;
+            }
+        }
+        const bool scatter = chase == NavGraph::NO_NODE || aiFrame < SCATTER_FRAMES;
+        aiFrame = (aiFrame + 1) % (SCATTER_FRAMES + CHASE_FRAMES);
+        if (!scatter)
+            flow.retarget(nav, chase);
+
+        auto& rng = World::resource<Rng>();
+        // the packed Intent pool (Pac-Man and the ghosts) drives this rather than every pellet id
+        World::each<Ghost, Intent, Collider, Position>([&](ent_type e) {
+            auto& in = World::getComponent<Intent>(e);
+            const auto& c = World::getComponent<Collider>(e);
+            const int at = nav.node(World::readComponent<Position>(e).p);
+            const int target = scatter ? scatterNodes[World::getComponent<Ghost>(e).corner] : chase;
+
+            const eDir current = in.up ? eDir::Up : in.left ? eDir::Left : in.down ? eDir::Down : in.right ? eDir::Right : eDir::None;
+            const eDir reverse = in.up ? eDir::Down : in.left ? eDir::Right : in.down ? eDir::Up : in.right ? eDir::Left : eDir::None;
+
+            auto distTo = [&](int n) { return scatter ? nav.distance(n, target) : flow.distance(n); };
+
+            eDir best = scatter ? nav.nextHop(at, target) : eDir::None;
+            if (best == eDir::None || best == reverse || !canMove(c.b, best)) {
+                best = eDir::None;
+                int bestDist = NavGraph::UNREACHABLE + 1;
+                int ties = 0;
+                for (eDir d : {eDir::Up, eDir::Left, eDir::Down, eDir::Right}) {
+                    if (d == reverse || !canMove(c.b, d))
+                        continue;
+                    const int n = nav.neighbour(at, d);
+                    const int dist = n == NavGraph::NO_NODE ? distTo(at) + 1 : distTo(n);
+                    if (dist < bestDist) {
+                        bestDist = dist;
+                        best = d;
+                        ties = 1;
                     }
+                    else if (dist == bestDist && rng.below(++ties) == 0)
+                        best = d;   // equally short: each tied direction is kept with equal odds
                 }
+                if (best == eDir::None && canMove(c.b, reverse))
+                    best = reverse;
             }
-        }
+
+            if (best != current && best != eDir::None)
+                steer(in, best);
+        });
     }
 
     /**
-    * @brief Removes all game entities except the background and destroys their physics bodies.
+    * @brief Queues the removal of all game entities except the background, with their physics bodies.
     */
     void PacMan::EndGameSystem() {
-        Mask notRequired = MaskBuilder()
+        constexpr Mask notRequired = MaskBuilder()
             .set<Background>()
             .build();
-        Mask required = MaskBuilder()
+        constexpr Mask required = MaskBuilder()
             .set<Collider>()
             .build();
         for (id_type id = 0; id <= World::maxId().id; ++id) {
             ent_type e{id};
             if (! World::mask(e).test(notRequired) && World::mask(e).test(required)) {
-                auto& c = World::getComponent<Collider>(e);
-                World::destroyEntity(e);
-                b2DestroyBody(c.b);
+                commands.destroy(e);
 
             }
         }
     }
 
+
     /**
-     * @brief Creates the main player character (Pac-Man).
-     * @param lives Number of lives to initialize Pac-Man with.
+     * @brief Creates Pac-Man's kinematic sensor body.
+     * @param p Center position in pixels.
      */
-    void PacMan::createPacMan(int lives) {
-        SDL_FPoint p = {13.f*CHARACTER_TEX_SCALE, 240.f*CHARACTER_TEX_SCALE};
-
+    b2BodyId PacMan::createPacManBody(SDL_FPoint p) {
         b2BodyDef pacmanBodyDef = b2DefaultBodyDef();
         pacmanBodyDef.type = b2_kinematicBody;
         pacmanBodyDef.position = {p.x / BOX_SCALE, p.y / BOX_SCALE};
@@ -365,10 +455,63 @@ namespace pacman
 
         b2Circle pacmanCircle = {0,0,(OPEN_PACMAN.w*CHARACTER_TEX_SCALE/BOX_SCALE)/2};
         b2CreateCircleShape(pacmanBody, &pacmanShapeDef, &pacmanCircle);
+        return pacmanBody;
+    }
+
+    /**
+     * @brief Creates a ghost's kinematic box body.
+     * @param size Box size in pixels.
+     * @param p Center position in pixels.
+     */
+    b2BodyId PacMan::createGhostBody(SDL_FPoint size, SDL_FPoint p) {
+        b2BodyDef padBodyDef = b2DefaultBodyDef();
+        padBodyDef.type = b2_kinematicBody;
+        //padBodyDef.type = b2_staticBody;
+        padBodyDef.position = {p.x / BOX_SCALE, p.y / BOX_SCALE};
+        b2BodyId padBody = b2CreateBody(boxWorld, &padBodyDef);
+
+        b2ShapeDef padShapeDef = b2DefaultShapeDef();
+        padShapeDef.enableSensorEvents = true;
+        padShapeDef.density = 1;
+
+        b2Polygon padBox = b2MakeBox((size.x/BOX_SCALE)/2, (size.y/BOX_SCALE)/2);
+        b2CreatePolygonShape(padBody, &padShapeDef, &padBox);
+        return padBody;
+    }
+
+    /**
+     * @brief Creates a pellet's static circle body.
+     * @param p Center position in pixels.
+     */
+    b2BodyId PacMan::createPelletBody(SDL_FPoint p) {
+        // 1. Create a static body
+        b2BodyDef pelletBodyDef = b2DefaultBodyDef();
+        pelletBodyDef.type = b2_staticBody;
+        pelletBodyDef.position = {p.x / BOX_SCALE, p.y / BOX_SCALE};
+        b2BodyId pelletBody = b2CreateBody(boxWorld, &pelletBodyDef);
+
+        // 2. Define shape
+        b2ShapeDef pelletShapeDef = b2DefaultShapeDef();
+        pelletShapeDef.enableSensorEvents = true;
+
+        pelletShapeDef.density = 1; // Not needed for static, but harmless
+
+        b2Circle pelletCircle = {0,0,PELLET.w*CHARACTER_TEX_SCALE/BOX_SCALE/2};
+        b2CreateCircleShape(pelletBody, &pelletShapeDef, &pelletCircle);
+        return pelletBody;
+    }
+
+    /**
+     * @brief Creates the main player character (Pac-Man).
+     * @param lives Number of lives to initialize Pac-Man with.
+     */
+    void PacMan::createPacMan(int lives) {
+        SDL_FPoint p = {13.f*CHARACTER_TEX_SCALE, 240.f*CHARACTER_TEX_SCALE};
+        b2BodyId pacmanBody = createPacManBody(p);
 
         Entity e = Entity::create();
         e.addAll(
-         Position{{},0},
+         Position{p,0},
          Drawable{{OPEN_PACMAN,CLOSE_PACMAN}, {OPEN_PACMAN.w*CHARACTER_TEX_SCALE, OPEN_PACMAN.h*CHARACTER_TEX_SCALE},0},
          Collider{pacmanBody},
          Intent{},
@@ -384,29 +527,19 @@ namespace pacman
      * @param r1 First frame of the ghost's sprite.
      * @param r2 Second frame of the ghost's sprite.
      * @param p Starting position of the ghost.
+     * @param corner Scatter corner of the ghost (see Ghost).
      */
 
-    void PacMan::createGhost(const SDL_FRect& r1,const SDL_FRect& r2, const SDL_FPoint& p) {
-        b2BodyDef padBodyDef = b2DefaultBodyDef();
-        padBodyDef.type = b2_kinematicBody;
-        //padBodyDef.type = b2_staticBody;
-        padBodyDef.position = {p.x / BOX_SCALE, p.y / BOX_SCALE};
-        b2BodyId padBody = b2CreateBody(boxWorld, &padBodyDef);
-
-        b2ShapeDef padShapeDef = b2DefaultShapeDef();
-        padShapeDef.enableSensorEvents = true;
-        padShapeDef.density = 1;
-
-        b2Polygon padBox = b2MakeBox((r1.w*CHARACTER_TEX_SCALE/BOX_SCALE)/2, (r1.h*CHARACTER_TEX_SCALE/BOX_SCALE)/2);
-        b2CreatePolygonShape(padBody, &padShapeDef, &padBox);
+    void PacMan::createGhost(const SDL_FRect& r1,const SDL_FRect& r2, const SDL_FPoint& p, int corner) {
+        b2BodyId padBody = createGhostBody({r1.w*CHARACTER_TEX_SCALE, r1.h*CHARACTER_TEX_SCALE}, p);
 
         Entity e = Entity::create();
         e.addAll(
-            Position{{},0},
+            Position{p,0},
             Drawable{{r1,r2}, {r1.w*CHARACTER_TEX_SCALE, r1.h*CHARACTER_TEX_SCALE},0},
             Collider{padBody},
             Intent{},
-            Ghost{}
+            Ghost{corner}
         );
         b2Body_SetUserData(padBody, new ent_type{e.entity()});
     }
@@ -416,25 +549,11 @@ namespace pacman
     * @param p Position of the pellet.
     */
     void PacMan::createPellet(SDL_FPoint p) {
-        // 1. Create a static body
-        b2BodyDef pelletBodyDef = b2DefaultBodyDef();
-        pelletBodyDef.type = b2_staticBody;
-        pelletBodyDef.position = {p.x / BOX_SCALE, p.y / BOX_SCALE};
-        b2BodyId pelletBody = b2CreateBody(boxWorld, &pelletBodyDef);
+        b2BodyId pelletBody = createPelletBody(p);
 
-        // 2. Define shape
-        b2ShapeDef pelletShapeDef = b2DefaultShapeDef();
-        pelletShapeDef.enableSensorEvents = true;
-
-        pelletShapeDef.density = 1; // Not needed for static, but harmless
-
-        b2Circle pelletCircle = {0,0,PELLET.w*CHARACTER_TEX_SCALE/BOX_SCALE/2};
-        b2CreateCircleShape(pelletBody, &pelletShapeDef, &pelletCircle);
-
-        // 3. Create and assign components
         Entity e = Entity::create();
         e.addAll(
-            Position{{}, 0},
+            Position{p, 0},
             Drawable{{PELLET,{}}, {PELLET.w * CHARACTER_TEX_SCALE, PELLET.h * CHARACTER_TEX_SCALE}, 0},
             Collider{pelletBody},
             Pellet{ePelletState::Normal}
@@ -450,31 +569,12 @@ namespace pacman
     */
     void PacMan::createWall(SDL_FPoint p, float w, float h)
     {
-        const float width = w;
-        const float height = h;
-
+        maze.fill({p.x - w/2, p.y - h/2, w, h});
 
-        b2BodyDef wallBodyDef = b2DefaultBodyDef();
-        wallBodyDef.type = b2_staticBody;
-        wallBodyDef.position = {p.x / BOX_SCALE, p.y / BOX_SCALE};
-
-        b2BodyId wallBody = b2CreateBody(boxWorld, &wallBodyDef);
-
-        b2ShapeDef shapeDef = b2DefaultShapeDef();
-        shapeDef.enableSensorEvents = true;
-        shapeDef.isSensor = true;
-        shapeDef.density = 1; // Not needed for static, but harmless
-
-        b2Polygon box = b2MakeBox(width / 2.0f / BOX_SCALE, height / 2.0f / BOX_SCALE);
-        b2ShapeId shape = b2CreatePolygonShape(wallBody, &shapeDef, &box);
-
-        Entity e = Entity::create();
-        e.addAll(
+        Entity::create().addAll(
                 Position{p, 0},
-                Collider{wallBody},
-                Wall{shape, {width, height}}
+                Wall{{w, h}}
         );
-        b2Body_SetUserData(wallBody, new ent_type{e.entity()});
     }
 
     /**
@@ -719,14 +819,290 @@ namespace pacman
         //right of middle box
         createWall({136 * CHARACTER_TEX_SCALE, 118 * CHARACTER_TEX_SCALE},7 * CHARACTER_TEX_SCALE, 30 * CHARACTER_TEX_SCALE);
     }
+    /**
+    * @brief Prepares a freshly loaded level for its first frames.
+    *
+    * Rebuilds the static broad-phase tree with a full SAH build (pellets are inserted one at a time),
+    * presizes the Box2D step arena to the peak measured so far and reserves bagel storage for the
+    * level's entities plus headroom for respawns. Also builds the ghost navigation tables from the maze.
+    *
+    * The first level in the process has no peak to go by, so it measures one with a warm-up step
+    * that the level start snapshot then undoes.
+    */
+    void PacMan::finalizeLevel()
+    {
+        b2World_RebuildStaticTree(boxWorld);
+
+        nav.build(maze, {RED_GHOST_RIGHT.w*CHARACTER_TEX_SCALE, RED_GHOST_RIGHT.h*CHARACTER_TEX_SCALE},
+            NAV_CELL, CHARACTER_TEX_SCALE);
+        flow = FlowField{};
+        scatterNodes[0] = nav.node({0, 0});
+        scatterNodes[1] = nav.node({WIN_WIDTH, 0});
+        scatterNodes[2] = nav.node({0, WIN_HEIGHT});
+        scatterNodes[3] = nav.node({WIN_WIDTH, WIN_HEIGHT});
+
+        static constexpr Mask pellet = MaskBuilder()
+            .set<Pellet>()
+            .set<Collider>()
+            .build();
+        tiles.build(nav);
+        lookahead.nav = &nav;
+        lookahead.value.assign(nav.count(), 0);
+        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
+            if (World::mask(e).test(pellet))
+                lookahead.value[nodeOf(World::getComponent<Collider>(e).b)] +=
+                    World::getComponent<Pellet>(e).type == ePelletState::Power ? 50 : 10;
+        }
+
+        compactIds();
+        const size_type n = World::maxId().id + 1 + ENTITY_HEADROOM;
+        World::reserve(n);
+        World::reserveComponents<PACMAN_COMPONENTS>(n, ENTITY_HEADROOM);
+
+        snapshot(levelStart);
+
+        b2ArenaAllocator* arena = &b2GetWorldFromId(boxWorld)->arena;
+        if (arenaPeak == 0) {
+            b2World_Step(boxWorld, BOX2D_STEP, 4);
+            arenaPeak = b2GetMaxArenaAllocation(arena);
+            restore(levelStart);
+        }
+        if (b2GetArenaCapacity(arena) < arenaPeak) {
+            b2DestroyArenaAllocator(arena);
+            *arena = b2CreateArenaAllocator(arenaPeak);
+        }
+    }
+
+    /**
+    * @brief Closes the holes that destroyed entities left in the id range, so scans stop at the last live one.
+    *
+    * Only valid between levels: levelStart and any queued commands hold the old ids. Bodies keep a
+    * pointer to their owner's id, which is translated in place.
+    */
+    void PacMan::compactIds()
+    {
+        static constexpr Mask mask = MaskBuilder()
+            .set<Collider>()
+            .build();
+
+        Remap remap;
+        commands.flush();
+        World::compact<PACMAN_COMPONENTS>(remap);
+        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
+            if (World::mask(e).test(mask)) {
+                auto* owner = static_cast<ent_type*>(b2Body_GetUserData(World::getComponent<Collider>(e).b));
+                *owner = remap(*owner);
+            }
+        }
+    }
+
+    /**
+    * @brief Captures the whole game state: bagel world, tick counters, Rng and every body's transform and velocity.
+    *
+    * All components are trivially copyable, so the world is a few bulk copies; bodies are saved
+    * in entity order after it. The maze and navigation tables are per level and not included.
+    */
+    void PacMan::snapshot(Snapshot& s) const
+    {
+        static constexpr Mask mask = MaskBuilder()
+            .set<Collider>()
+            .build();
+
+        World::snapshot<PACMAN_COMPONENTS>(s);
+        s.write(&tick, sizeof(tick));
+        s.write(&aiFrame, sizeof(aiFrame));
+        s.write(&World::resource<Rng>(), sizeof(Rng));
+        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
+            if (World::mask(e).test(mask)) {
+                const b2BodyId b = World::getComponent<Collider>(e).b;
+                const BodyState st{b2Body_GetTransform(b), b2Body_GetLinearVelocity(b)};
+                s.write(&st, sizeof(st));
+            }
+        }
+    }
+
+    /**
+    * @brief Returns the game to a state captured by snapshot() on this instance.
+    *
+    * Bodies that still exist are patched in place (and only if they moved); bodies created since the
+    * snapshot are destroyed and bodies destroyed since (eaten pellets, respawned characters) are rebuilt.
+    */
+    void PacMan::restore(const Snapshot& s)
+    {
+        static constexpr Mask mask = MaskBuilder()
+            .set<Collider>()
+            .build();
+
+        liveBodies.clear();
+        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
+            if (World::mask(e).test(mask))
+                liveBodies.push_back(World::getComponent<Collider>(e).b);
+        }
+
+        size_type at = World::restore<PACMAN_COMPONENTS>(s);
+        s.read(at, &tick, sizeof(tick));
+        s.read(at, &aiFrame, sizeof(aiFrame));
+        s.read(at, &World::resource<Rng>(), sizeof(Rng));
+
+        for (b2BodyId b : liveBodies) {
+            auto* owner = static_cast<ent_type*>(b2Body_GetUserData(b));
+            const ent_type e = *owner;
+            if (e.id <= World::maxId().id && World::mask(e).test(mask) && B2_ID_EQUALS(World::getComponent<Collider>(e).b, b))
+                continue;
+            destroyBody(b);
+        }
+
+        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
+            if (!World::mask(e).test(mask))
+                continue;
+            BodyState st;
+            s.read(at, &st, sizeof(st));
+            auto& c = World::getComponent<Collider>(e);
+            if (!b2Body_IsValid(c.b)) {
+                const SDL_FPoint p = {st.t.p.x*BOX_SCALE, st.t.p.y*BOX_SCALE};
+                if (World::mask(e).test(Component<PlayerControlled>::Bit))
+                    c.b = createPacManBody(p);
+                else if (World::mask(e).test(Component<Ghost>::Bit))
+                    c.b = createGhostBody(World::getComponent<Drawable>(e).size, p);
+                else
+                    c.b = createPelletBody(p);
+                b2Body_SetUserData(c.b, new ent_type{e});
+            }
+            const b2Transform t = b2Body_GetTransform(c.b);
+            if (memcmp(&t, &st.t, sizeof(t)) != 0)
+                b2Body_SetTransform(c.b, st.t.p, st.t.q);
+            if (b2Body_GetType(c.b) != b2_staticBody)
+                b2Body_SetLinearVelocity(c.b, st.v);
+        }
+    }
+
+    /**
+    * @brief Captures the live game as the root of a lookahead search.
+    */
+    Branch PacMan::branch() const
+    {
+        static constexpr Mask player = MaskBuilder()
+            .set<PlayerControlled>()
+            .set<Collider>()
+            .build();
+        static constexpr Mask ghost = MaskBuilder()
+            .set<Ghost>()
+            .set<Collider>()
+            .build();
+        static constexpr Mask pellet = MaskBuilder()
+            .set<Pellet>()
+            .set<Collider>()
+            .build();
+
+        auto heading = [](const Intent& in) {
+            return in.up ? eDir::Up : in.left ? eDir::Left : in.down ? eDir::Down : in.right ? eDir::Right : eDir::None;
+        };
+
+        int pac = 0;
+        eDir dir = eDir::None;
+        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
+            if (World::mask(e).test(player)) {
+                pac = nodeOf(World::getComponent<Collider>(e).b);
+                dir = heading(World::getComponent<Intent>(e));
+                break;
+            }
+        }
+
+        Branch b(lookahead, pac, dir);
+        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
+            if (World::mask(e).test(ghost))
+                b.addGhost(nodeOf(World::getComponent<Collider>(e).b), heading(World::getComponent<Intent>(e)));
+            else if (World::mask(e).test(pellet))
+                b.addPellet(nodeOf(World::getComponent<Collider>(e).b));
+        }
+        return b;
+    }
+
+    /**
+    * @brief Advances one tick with the player holding action, as InputSystem would apply a held key.
+    *
+    * A direction the player is blocked in is ignored until the block clears; None leaves the intent alone.
+    */
+    void PacMan::step(eDir action)
+    {
+        if (action != eDir::None) {
+            World::each<PlayerControlled, Intent>([action](ent_type e) {
+                auto& in = World::getComponent<Intent>(e);
+                const bool blocked =
+                    (action == eDir::Up && in.blockedUp) || (action == eDir::Down && in.blockedDown) ||
+                    (action == eDir::Left && in.blockedLeft) || (action == eDir::Right && in.blockedRight);
+                if (!blocked)
+                    steer(in, action);
+            });
+        }
+        simulate();
+    }
+
+    /**
+    * @brief Score and lives of the player, or null once the game is over.
+    */
+    const PlayerStats* PacMan::stats() const
+    {
+        static constexpr Mask mask = MaskBuilder()
+            .set<PlayerStats>()
+            .build();
+
+        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
+            if (World::mask(e).test(mask))
+                return &World::getComponent<PlayerStats>(e);
+        }
+        return nullptr;
+    }
+
+    /**
+    * @brief Saves this instance's bagel world (and the Rng) so another instance can use the global World.
+    *
+    * Unlike snapshot() the Box2D world is left alone: it belongs to this instance and does not change
+    * while the instance is suspended.
+    */
+    void PacMan::suspend(Snapshot& s) const
+    {
+        World::snapshot<PACMAN_COMPONENTS>(s);
+        s.write(&World::resource<Rng>(), sizeof(Rng));
+    }
+
+    /**
+    * @brief Reinstates the bagel world saved by suspend().
+    */
+    void PacMan::resume(const Snapshot& s)
+    {
+        size_type at = World::restore<PACMAN_COMPONENTS>(s);
+        s.read(at, &World::resource<Rng>(), sizeof(Rng));
+    }
+
+    void PacMan::clearWorld()
+    {
+        World::release<PACMAN_COMPONENTS>();
+    }
+
+    /**
+    * @brief Puts the level back as it was loaded, without tearing down and re-creating the world.
+    *
+    * The Rng keeps running rather than rewinding with the level, so each new round breaks ghost ties
+    * differently while the whole run stays reproducible from the seed.
+    */
+    void PacMan::restart()
+    {
+        const Rng rng = World::resource<Rng>();
+        restore(levelStart);
+        World::resource<Rng>() = rng;
+    }
+
     /**
     * @brief Constructs the PacMan game instance, initializing systems, walls, pellets, and entities.
+    * @param seed Seed of the world's Rng resource; a run is reproducible from it.
+    * @param headless Skips the window and texture; such an instance can only replay().
     */
-    PacMan::PacMan()
+    PacMan::PacMan(uint64_t seed, bool headless) : headless(headless)
     {
-        if (!prepareWindowAndTexture())
+        if (!headless && !prepareWindowAndTexture())
             return;
-        SDL_srand(time(nullptr));
+        World::resource<Rng>().seed(seed);
 
         prepareBoxWorld();
         prepareWalls();
@@ -736,18 +1112,22 @@ namespace pacman
 
         createPacMan(3);
 
-        createGhost(BLUE_GHOST_DDOWN,BLUE_GHOST_DOWN_1,{100 * CHARACTER_TEX_SCALE, 120.f * CHARACTER_TEX_SCALE});
-        createGhost(PINK_GHOST_LEFT,PINK_GHOST_LEFT_1,{(110 + PINK_GHOST_DDOWN.w)*CHARACTER_TEX_SCALE, 120.f * CHARACTER_TEX_SCALE});
-        createGhost(RED_GHOST_UP,RED_GHOST_UP_1, {100 * CHARACTER_TEX_SCALE, (120.f - (RED_GHOST_DDOWN.h + 15)) * CHARACTER_TEX_SCALE});
-        createGhost(ORANGE_GHOST_RIGHT,ORANGE_GHOST_RIGHT_1,{(110 + PINK_GHOST_DDOWN.w)*CHARACTER_TEX_SCALE, (120.f - (RED_GHOST_DDOWN.h + 15)) * CHARACTER_TEX_SCALE});
+        createGhost(BLUE_GHOST_DDOWN,BLUE_GHOST_DOWN_1,{100 * CHARACTER_TEX_SCALE, 120.f * CHARACTER_TEX_SCALE}, 3);
+        createGhost(PINK_GHOST_LEFT,PINK_GHOST_LEFT_1,{(110 + PINK_GHOST_DDOWN.w)*CHARACTER_TEX_SCALE, 120.f * CHARACTER_TEX_SCALE}, 0);
+        createGhost(RED_GHOST_UP,RED_GHOST_UP_1, {100 * CHARACTER_TEX_SCALE, (120.f - (RED_GHOST_DDOWN.h + 15)) * CHARACTER_TEX_SCALE}, 1);
+        createGhost(ORANGE_GHOST_RIGHT,ORANGE_GHOST_RIGHT_1,{(110 + PINK_GHOST_DDOWN.w)*CHARACTER_TEX_SCALE, (120.f - (RED_GHOST_DDOWN.h + 15)) * CHARACTER_TEX_SCALE}, 2);
+
+        finalizeLevel();
     }
     /**
     * @brief Cleans up and destroys SDL and Box2D resources.
     */
     PacMan::~PacMan()
     {
-        if (b2World_IsValid(boxWorld))
+        if (b2World_IsValid(boxWorld)) {
+            arenaPeak = std::max(arenaPeak, b2World_GetCounters(boxWorld).stackUsed);
             b2DestroyWorld(boxWorld);
+        }
         if (tex != nullptr)
             SDL_DestroyTexture(tex);
         if (ren != nullptr)
@@ -757,22 +1137,35 @@ namespace pacman
 
         SDL_Quit();
     }
+    /**
+    * @brief Advances the game logic by one tick; shared by the interactive loop and replays.
+    */
+    void PacMan::simulate()
+    {
+        AISystem();
+        MovementSystem();
+        box_system();
+        CollisionSystem();
+        ++tick;
+    }
+
     /**
     * @brief Main game loop that processes input, updates logic, renders, and handles events.
+    * @param record If not null, receives every input change; it is closed when the loop exits.
     */
-    void PacMan::run()
+    void PacMan::run(InputRecording* record)
     {
+        recording = record;
         SDL_SetRenderDrawColor(ren, 0,0,0,255);
         auto start = SDL_GetTicks();
         bool quit = false;
 
         while (!quit) {
 
+            if (recording != nullptr && recording->needsKeyframe(tick))
+                snapshot(recording->keyframe(tick));
             InputSystem();
-            AISystem();
-            MovementSystem();
-            box_system();
-            CollisionSystem();
+            simulate();
             RenderSystem();
 
             auto end = SDL_GetTicks();
@@ -789,5 +1182,56 @@ namespace pacman
                     quit = true;
             }
         }
+        if (recording != nullptr)
+            recording->finish(tick);
+        recording = nullptr;
+    }
+
+    /**
+    * @brief Feeds a recording back through the game logic at uncapped speed, without rendering.
+    *
+    * The instance must have been constructed with the recording's seed. Keyframes the recording
+    * lacks are taken on the way, so a later seek() can start near any tick.
+    * @param from Tick to start from; see seek().
+    * @return Number of ticks simulated after from.
+    */
+    uint32_t PacMan::replay(InputRecording& rec, uint32_t from)
+    {
+        InputRecording::Reader reader = seek(rec, from);
+        const uint32_t first = tick;
+        while (!reader.done(tick)) {
+            if (rec.needsKeyframe(tick))
+                snapshot(rec.keyframe(tick, reader));
+            ReplaySystem(reader);
+            simulate();
+        }
+        return tick - first;
+    }
+
+    /**
+    * @brief Brings the game to tick to of a recording: restores the last keyframe at or before it and
+    * replays the remaining ticks.
+    *
+    * Without such a keyframe the instance must still be at its first tick, as after construction.
+    * @return A reader positioned at to, for the caller to continue the replay with.
+    */
+    InputRecording::Reader PacMan::seek(InputRecording& rec, uint32_t to)
+    {
+        const InputRecording::Keyframe* k = rec.keyframeBefore(to);
+        if (k != nullptr)
+            restore(k->state);
+        InputRecording::Reader reader = k != nullptr ? InputRecording::Reader(rec, *k) : InputRecording::Reader(rec);
+        while (tick < to && !reader.done(tick)) {
+            if (rec.needsKeyframe(tick))
+                snapshot(rec.keyframe(tick, reader));
+            ReplaySystem(reader);
+            simulate();
+        }
+        return reader;
     }
 }// namespace PacMan
+
+void bagel::Observer<pacman::Collider>::onRemove(ent_type e)
+{
+    pacman::destroyBody(World::getComponent<pacman::Collider>(e).b);
+}
@@ -2,6 +2,12 @@
 #include <SDL3/SDL.h>
 #include <box2d/box2d.h>
 #include "bagel.h"
+#include "Maze.h"
+#include "NavGraph.h"
+#include "Rng.h"
+#include "Replay.h"
+#include "Lookahead.h"
+#include "TileEncoder.h"
 /**
  * @file PacMan.h
  * @brief Declarations for the core components, systems, and entity factories of a Pac-Man game.
@@ -25,30 +31,30 @@ namespace pacman{
     /**
      * @brief Component representing an entity's position on the grid.
      */
-    using Position = struct {SDL_FPoint p; float a;};
+    struct Position {SDL_FPoint p; float a;};
 
     /**
      * @brief Component representing sprite animation state for rendering.
      */
-    using Drawable = struct { SDL_FRect part[2]; SDL_FPoint size; size_t frame; };
+    struct Drawable { SDL_FRect part[2]; SDL_FPoint size; size_t frame; };
 
 
     /**
      * @brief Component that defines an entity's hitbox size for collision detection.
      */
-    using Collider = struct { b2BodyId b; };
+    struct Collider { b2BodyId b; };
 
 
     /**
      * @brief Component that stores the last input from a player.
      */
-    using Input = struct { SDL_Scancode up, down, right, left; };
+    struct Input { SDL_Scancode up, down, right, left; };
 
 
     /**
      * @brief Component that expresses the current intended action of an entity.
      */
-    using Intent = struct {
+    struct Intent {
         bool up = false, down = false, left = false, right = false;
         bool blockedUp = false, blockedDown = false, blockedLeft = false, blockedRight = false;
     };
@@ -74,14 +80,16 @@ namespace pacman{
     struct PlayerControlled { };
 
     /**
-     * @brief Tag component to identify ghost entities.
+     * @brief Component identifying ghost entities.
      */
-    struct Ghost { };
+    struct Ghost {
+        int corner = 0; ///< scatter target: 0 top-left, 1 top-right, 2 bottom-left, 3 bottom-right
+    };
 
     /**
-     * @brief Tag component for wall entities.
+     * @brief Tag component for wall entities. Walls are rasterized into the Maze grid and have no physics body.
      */
-    struct Wall {b2ShapeId s; SDL_FPoint size;};
+    struct Wall {SDL_FPoint size;};
 
 	/**
 	* @brief Tag component for Background entities.
@@ -91,14 +99,36 @@ namespace pacman{
 
     class PacMan {
     public:
-        PacMan();
+        explicit PacMan(uint64_t seed, bool headless = false);
         ~PacMan();
 
-        void run();
+        void run(InputRecording* record = nullptr);
+        uint32_t replay(InputRecording& rec, uint32_t from = 0);
+        InputRecording::Reader seek(InputRecording& rec, uint32_t to);
+
+        void snapshot(Snapshot& s) const;
+        void restore(const Snapshot& s);
+        void restart();
+
+        Branch branch() const;
+
+        void step(eDir action);
+        const PlayerStats* stats() const;
+        void suspend(Snapshot& s) const;
+        void resume(const Snapshot& s);
+        /// empties the bagel world and gives back its memory, without touching any instance's Box2D world,
+        /// for the next instance to load into
+        static void clearWorld();
+
+        const TileEncoder& encoder() const { return tiles; }
 
         bool valid();
 	private:
+        void simulate();
+
         void InputSystem();
+        void ReplaySystem(InputRecording::Reader& reader);
+        void steerPlayers(eDir d);
         void AISystem();
         void MovementSystem();
         void CollisionSystem();
@@ -106,8 +136,16 @@ namespace pacman{
         void box_system();
     	void EndGameSystem();
 
+        bool wallAhead(b2BodyId b, b2Vec2 translation) const;
+        bool canMove(b2BodyId b, eDir d) const;
+        int nodeOf(b2BodyId b) const;
+
+        b2BodyId createPacManBody(SDL_FPoint p);
+        b2BodyId createGhostBody(SDL_FPoint size, SDL_FPoint p);
+        b2BodyId createPelletBody(SDL_FPoint p);
+
         void createPacMan(int lives);
-        void createGhost(const SDL_FRect& r1, const SDL_FRect& r2, const SDL_FPoint& p);
+        void createGhost(const SDL_FRect& r1, const SDL_FRect& r2, const SDL_FPoint& p, int corner);
         void createPellet(SDL_FPoint p);
         void createScore(float n_life);
         void createWall(SDL_FPoint p, float w, float h);
@@ -117,6 +155,8 @@ namespace pacman{
         void prepareBoxWorld();
         void prepareWalls();
     	void preparePellets();
+        void finalizeLevel();
+        void compactIds();
 
         static constexpr SDL_FRect BOARD{ 227, 0, 226, 253 };
         static constexpr SDL_FRect PELLET{ 19, 11, 2, 2 };
@@ -128,9 +168,26 @@ namespace pacman{
         static constexpr int	WIN_WIDTH = BOARD.w * CHARACTER_TEX_SCALE;
         static constexpr int	WIN_HEIGHT = BOARD.h * CHARACTER_TEX_SCALE;
         static constexpr int	FPS = 60;
+    public:
+        /// board size in pixels
+        static constexpr int	WIDTH = WIN_WIDTH;
+        static constexpr int	HEIGHT = WIN_HEIGHT;
+    private:
 
         static constexpr float	GAME_FRAME = 1000.f/FPS;
         static constexpr float	RAD_TO_DEG = 57.2958f;
+        static constexpr float	BOX2D_STEP = 1.f/FPS;
+        static constexpr float	MOVE_SPEED = 20;
+
+        static constexpr float	NAV_CELL = 8 * CHARACTER_TEX_SCALE;
+        static constexpr int	SCATTER_FRAMES = 7 * FPS;
+        static constexpr int	CHASE_FRAMES = 20 * FPS;
+
+        /// spare entity ids, and spare slots in each packed component array, reserved past the loaded level for respawns
+        static constexpr int	ENTITY_HEADROOM = 16;
+
+        /// sideways tolerance (pixels) so bodies grazing a wall can still slide along it
+        static constexpr float	WALL_SKIN = 1.f;
 
     	static constexpr float	PAD_TEX_SCALE = 1.f;//0.25f;
 
@@ -185,11 +242,57 @@ namespace pacman{
 		static constexpr SDL_FRect ORANGE_GHOST_DDOWN{ 553, 113, 14, 15 };
 		static constexpr SDL_FRect ORANGE_GHOST_DOWN_1{ 569, 113, 14, 15 };
 
-        SDL_Texture* tex;
-        SDL_Renderer* ren;
-        SDL_Window* win;
+        SDL_Texture* tex = nullptr;
+        SDL_Renderer* ren = nullptr;
+        SDL_Window* win = nullptr;
+        bool headless = false;
+
+        uint32_t tick = 0;
+        InputRecording* recording = nullptr;
 
         b2WorldId boxWorld = b2_nullWorldId;
+        Maze maze{WIN_WIDTH, WIN_HEIGHT};
+        NavGraph nav;
+        FlowField flow;
+        LookaheadLevel lookahead;
+        TileEncoder tiles;
+        int scatterNodes[4] = {};
+        int aiFrame = 0;
+
+        /// the level as finalizeLevel() left it, for restart()
+        Snapshot levelStart;
+        /// structural changes queued by systems while they iterate
+        CommandBuffer commands;
+        /// scratch list of live bodies used by restore()
+        std::vector<b2BodyId> liveBodies;
+
+        /// largest Box2D step-arena usage measured so far, shared by every level in the process;
+        /// seeded by the first level's warm-up step, raised by each instance's counters when it is destroyed
+        static inline int arenaPeak = 0;
 
     };
 } // namespace PacMan
+
+/**
+ * @brief Removing a Collider, or destroying its entity, destroys the Box2D body with it.
+ */
+template <>
+struct bagel::Observer<pacman::Collider> {
+    static void onRemove(ent_type e);
+};
+
+namespace pacman {
+    /// entities that move: MovementSystem walks the packed Intent and Collider arrays side by side
+    using Movers = bagel::Group<Intent, Collider>;
+}
+
+template <>
+struct bagel::Owner<pacman::Intent> { using type = pacman::Movers; };
+template <>
+struct bagel::Owner<pacman::Collider> { using type = pacman::Movers; };
+
+/**
+ * @brief Drawable's field arrays for the SplitStorage chosen in bagel_cfg.h; the animation pass in RenderSystem
+ * walks only the frame counters.
+ */
+BAGEL_SPLIT(pacman::Drawable, part, size, frame)
@@ -8,6 +8,7 @@
 using namespace std;
 
 #include "bagel.h"
+#include "Rng.h"
 using namespace bagel;
 
 namespace pong
@@ -34,11 +35,12 @@ namespace pong
 		b2BodyId ballBody = b2CreateBody(boxWorld, &ballBodyDef);
 		b2CreateCircleShape(ballBody, &ballShapeDef, &ballCircle);
 
-		float xs = SDL_randf()/2+.25f;
-		if (SDL_rand(2))
+		auto& rng = World::resource<Rng>();
+		float xs = rng.unit()/2+.25f;
+		if (rng.below(2))
 			xs = -xs;
 		float ys = SDL_sqrtf(1-xs*xs);
-		if (SDL_rand(2))
+		if (rng.below(2))
 			ys = -ys;
 		b2Body_SetLinearVelocity(ballBody, {xs*30,ys*30});
 
@@ -291,11 +293,11 @@ namespace pong
 		SDL_RenderPresent(ren);
 	}
 
-	Pong::Pong()
+	Pong::Pong(uint64_t seed)
 	{
 		if (!prepareWindowAndTexture())
 			return;
-		SDL_srand(time(nullptr));
+		World::resource<Rng>().seed(seed);
 
 		prepareBoxWorld();
 		prepareWalls();
@@ -14,7 +14,8 @@ namespace pong
 	class Pong
 	{
 	public:
-		Pong();
+		/// @param seed seeds the world's Rng resource
+		explicit Pong(uint64_t seed);
 		~Pong();
 
 		/// game loop
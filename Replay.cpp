@@ -0,0 +1,122 @@
+#include "Replay.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace pacman
+{
+    static constexpr char MAGIC[4] = {'P','M','R','P'};
+
+    void InputRecording::put(uint32_t tick, uint8_t code)
+    {
+        uint64_t v = (static_cast<uint64_t>(tick - _last) << 3) | code;
+        _last = tick;
+        do {
+            const uint8_t b = v & 0x7F;
+            v >>= 7;
+            _bytes.push_back(v ? b | 0x80 : b);
+        } while (v);
+    }
+
+    void InputRecording::push(uint32_t tick, eDir d)
+    {
+        put(tick, static_cast<uint8_t>(d));
+    }
+
+    void InputRecording::finish(uint32_t tick)
+    {
+        put(tick, END);
+    }
+
+    /**
+     * @brief Writes the header (magic, version, seed) followed by the varint stream.
+     * @return False if the file cannot be written.
+     */
+    bool InputRecording::save(const char* path) const
+    {
+        FILE* f = fopen(path, "wb");
+        if (f == nullptr)
+            return false;
+        bool ok = fwrite(MAGIC, 1, sizeof(MAGIC), f) == sizeof(MAGIC);
+        ok = ok && fputc(VERSION, f) != EOF;
+        ok = ok && fwrite(&_seed, sizeof(_seed), 1, f) == 1;
+        ok = ok && fwrite(_bytes.data(), 1, _bytes.size(), f) == _bytes.size();
+        return fclose(f) == 0 && ok;
+    }
+
+    /**
+     * @brief Reads a recording written by save().
+     * @return False if the file is missing or not a recording of this version.
+     */
+    bool InputRecording::load(const char* path)
+    {
+        FILE* f = fopen(path, "rb");
+        if (f == nullptr)
+            return false;
+        char magic[sizeof(MAGIC)];
+        bool ok = fread(magic, 1, sizeof(magic), f) == sizeof(magic) && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+        ok = ok && fgetc(f) == VERSION;
+        ok = ok && fread(&_seed, sizeof(_seed), 1, f) == 1;
+        _bytes.clear();
+        int c;
+        while (ok && (c = fgetc(f)) != EOF)
+            _bytes.push_back(static_cast<uint8_t>(c));
+        fclose(f);
+        _last = 0;
+        _keyframes.clear();
+        return ok;
+    }
+
+    bagel::Snapshot& InputRecording::keyframe(uint32_t tick)
+    {
+        _keyframes.push_back({tick, _bytes.size(), _last, {}});
+        return _keyframes.back().state;
+    }
+
+    bagel::Snapshot& InputRecording::keyframe(uint32_t tick, const Reader& at)
+    {
+        _keyframes.push_back({tick, at._start, at._last, {}});
+        return _keyframes.back().state;
+    }
+
+    const InputRecording::Keyframe* InputRecording::keyframeBefore(uint32_t tick) const
+    {
+        auto k = std::upper_bound(_keyframes.begin(), _keyframes.end(), tick,
+            [](uint32_t t, const Keyframe& k) { return t < k.tick; });
+        return k == _keyframes.begin() ? nullptr : &*(k - 1);
+    }
+
+    /**
+     * @brief Decodes the next change. A truncated stream, or a varint longer than the 5 bytes a
+     * 32-bit delta and its code need, stops the replay.
+     */
+    void InputRecording::Reader::advance()
+    {
+        uint64_t v = 0;
+        int shift = 0;
+        _start = _pos;
+        _last = _tick;
+        while (_pos < _r._bytes.size()) {
+            const uint8_t b = _r._bytes[_pos++];
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                _tick += static_cast<uint32_t>(v >> 3);
+                _code = v & 7;
+                return;
+            }
+            shift += 7;
+            if (shift >= 35)
+                break;
+        }
+        _code = END + 1;
+    }
+
+    bool InputRecording::Reader::poll(uint32_t tick, eDir& d)
+    {
+        if (_code >= END || _tick != tick)
+            return false;
+        d = static_cast<eDir>(_code);
+        advance();
+        return true;
+    }
+} // namespace pacman
@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "bagel.h"
+#include "NavGraph.h"
+/**
+ * @file Replay.h
+ * @brief Compact recording of the player's input for deterministic replays.
+ *
+ * Only the ticks where InputSystem changes the player's Intent are stored, together with the Rng seed.
+ * Each change is one LEB128 varint holding (ticks since the previous change << 3 | code), so a typical
+ * minute of play fits in a few hundred bytes. Code 0-3 is an eDir, code END marks the last tick.
+ *
+ * Every KEYFRAME_TICKS ticks the recorder and the replay loop also keep a full game snapshot, so a replay
+ * can seek to any tick by restoring the keyframe before it. Keyframes stay in memory and are not saved:
+ * they hold Box2D body ids that are only valid in the instance that took them.
+ */
+
+namespace pacman {
+
+    class InputRecording {
+    public:
+        explicit InputRecording(uint64_t seed = 0) : _seed(seed) {}
+
+        /// records that InputSystem turned the player toward d on this tick
+        void push(uint32_t tick, eDir d);
+        /// closes the stream at the given tick; replays run until they reach it
+        void finish(uint32_t tick);
+
+        bool save(const char* path) const;
+        bool load(const char* path);
+
+        uint64_t seed() const { return _seed; }
+        size_t bytes() const { return _bytes.size(); }
+
+        static constexpr uint32_t KEYFRAME_TICKS = 600;
+
+        /**
+         * @brief Full game state at a tick, with the stream position of the first change at or after it.
+         */
+        struct Keyframe {
+            uint32_t tick;
+            size_t pos;         ///< offset of the next change in the stream
+            uint32_t last;      ///< tick of the change before it, which its delta is relative to
+            bagel::Snapshot state;
+        };
+
+        class Reader;
+        /// true if tick is due a keyframe that has not been taken yet
+        bool needsKeyframe(uint32_t tick) const {
+            return tick % KEYFRAME_TICKS == 0 && (_keyframes.empty() || _keyframes.back().tick < tick);
+        }
+        /// appends a keyframe after the changes pushed so far; the caller fills in its state
+        bagel::Snapshot& keyframe(uint32_t tick);
+        /// appends a keyframe at the reader's position; the caller fills in its state
+        bagel::Snapshot& keyframe(uint32_t tick, const Reader& at);
+        /// the last keyframe at or before tick, or null if there is none
+        const Keyframe* keyframeBefore(uint32_t tick) const;
+
+        /**
+         * @brief Sequential reader used by the replay loop.
+         */
+        class Reader {
+        public:
+            explicit Reader(const InputRecording& r) : _r(r) { advance(); }
+            /// starts reading at a keyframe, as if the changes before it had been polled
+            Reader(const InputRecording& r, const Keyframe& k) : _r(r), _pos(k.pos), _tick(k.last) { advance(); }
+            /// pops the change recorded for this tick, if any
+            bool poll(uint32_t tick, eDir& d);
+            /// true once the end tick has been reached (or the stream is exhausted)
+            bool done(uint32_t tick) const { return _code == END ? tick >= _tick : _code > END; }
+        private:
+            friend class InputRecording;
+            void advance();
+
+            const InputRecording& _r;
+            size_t _pos = 0;
+            size_t _start = 0;      ///< offset of the pending change
+            uint32_t _last = 0;     ///< tick of the change before the pending one
+            uint32_t _tick = 0;
+            uint8_t _code = END;
+        };
+    private:
+        static constexpr uint8_t END = 4;
+        static constexpr uint8_t VERSION = 1;
+
+        void put(uint32_t tick, uint8_t code);
+
+        uint64_t _seed;
+        uint32_t _last = 0;
+        std::vector<uint8_t> _bytes;
+        std::vector<Keyframe> _keyframes;
+    };
+} // namespace pacman
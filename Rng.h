@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+/**
+ * @file Rng.h
+ * @brief Small seedable PCG32 generator.
+ *
+ * The state is two plain integers, so a generator can live in a bagel resource, be copied into
+ * snapshots and replayed bit-for-bit from its seed. No hidden global state is touched. It sits in
+ * namespace bagel next to World::resource(), so every game holds one the same way.
+ */
+
+namespace bagel {
+
+    class Rng
+    {
+    public:
+        explicit Rng(uint64_t s = 0) { seed(s); }
+
+        /// restarts the sequence; different streams give independent sequences for the same seed
+        void seed(uint64_t s, uint64_t stream = 0xda3e39cb94b95bdbULL) {
+            _state = 0;
+            _inc = (stream << 1) | 1;
+            next();
+            _state += s;
+            next();
+        }
+
+        uint32_t next() {
+            const uint64_t old = _state;
+            _state = old * 6364136223846793005ULL + _inc;
+            const uint32_t xorshifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+            const uint32_t rot = static_cast<uint32_t>(old >> 59);
+            return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+        }
+
+        /// uniform integer in [0,n) (multiply-shift, bias is negligible for small n)
+        uint32_t below(uint32_t n) { return static_cast<uint32_t>((static_cast<uint64_t>(next()) * n) >> 32); }
+
+        /// uniform float in [0,1)
+        float unit() { return static_cast<float>(next() >> 8) * (1.f / 16777216.f); }
+    private:
+        uint64_t _state;
+        uint64_t _inc;
+    };
+} // namespace bagel
@@ -0,0 +1,78 @@
+#include "TileEncoder.h"
+#include <algorithm>
+#include <cstring>
+#include "Pacman.h"
+
+namespace pacman
+{
+    void TileEncoder::build(const NavGraph& nav)
+    {
+        _cols = nav.cols();
+        _rows = nav.rows();
+        _cell = nav.cellSize();
+        const int cells = _cols * _rows;
+        _planeWords = (cells + 63) / 64;
+
+        _walls.assign(cells, 1);
+        for (int n = 0; n < nav.count(); ++n)
+            _walls[nav.cell(n)] = 0;
+
+        _packedWalls.assign(_planeWords, 0);
+        for (int c = 0; c < cells; ++c) {
+            if (_walls[c])
+                _packedWalls[c / 64] |= 1ULL << (c % 64);
+        }
+    }
+
+    /**
+     * @brief Calls f(plane, cell) for every pellet, power pellet, ghost and Pac-Man on the board.
+     */
+    template <class F>
+    void TileEncoder::dynamicCells(F&& f) const
+    {
+        static constexpr Mask pellet = MaskBuilder()
+            .set<Pellet>()
+            .set<Position>()
+            .build();
+        static constexpr Mask ghost = MaskBuilder()
+            .set<Ghost>()
+            .set<Position>()
+            .build();
+        static constexpr Mask player = MaskBuilder()
+            .set<PlayerControlled>()
+            .set<Position>()
+            .build();
+
+        for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
+            const Mask& m = World::mask(e);
+            Plane plane;
+            if (m.test(pellet))
+                plane = World::readComponent<Pellet>(e).type == ePelletState::Power ? POWER : PELLET;
+            else if (m.test(ghost))
+                plane = GHOST;
+            else if (m.test(player))
+                plane = PACMAN;
+            else
+                continue;
+            const auto& p = World::readComponent<Position>(e).p;
+            const int cx = std::clamp(static_cast<int>(p.x / _cell), 0, _cols - 1);
+            const int cy = std::clamp(static_cast<int>(p.y / _cell), 0, _rows - 1);
+            f(plane, cy * _cols + cx);
+        }
+    }
+
+    void TileEncoder::encode(uint8_t* out) const
+    {
+        const size_t cells = static_cast<size_t>(_cols) * _rows;
+        memcpy(out, _walls.data(), cells);
+        memset(out + cells, 0, cells * (PLANES - 1));
+        dynamicCells([&](Plane plane, int c) { out[plane * cells + c] = 1; });
+    }
+
+    void TileEncoder::encodePacked(uint64_t* out) const
+    {
+        memcpy(out, _packedWalls.data(), _planeWords * sizeof(uint64_t));
+        memset(out + _planeWords, 0, _planeWords * (PLANES - 1) * sizeof(uint64_t));
+        dynamicCells([&](Plane plane, int c) { out[plane * _planeWords + c / 64] |= 1ULL << (c % 64); });
+    }
+} // namespace pacman
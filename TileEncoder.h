@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "NavGraph.h"
+/**
+ * @file TileEncoder.h
+ * @brief Compact observation of the game as a stack of binary tile planes.
+ *
+ * The planes share the navigation cell grid (29x32 cells on the default board) and are filled straight
+ * from the bagel storages, without rendering. A plane is either one byte per cell or one bit per cell,
+ * row-major, each plane starting on a fresh 64-bit word when packed.
+ */
+
+namespace pacman {
+
+    class TileEncoder {
+    public:
+        enum Plane { WALL, PELLET, POWER, GHOST, PACMAN, PLANES };
+
+        /// takes the grid from nav and rasterizes the static wall plane (cells where a ghost cannot stand)
+        void build(const NavGraph& nav);
+
+        int cols() const { return _cols; }
+        int rows() const { return _rows; }
+        /// bytes written by encode()
+        size_t size() const { return static_cast<size_t>(PLANES) * _cols * _rows; }
+        /// words written by encodePacked()
+        size_t packedSize() const { return static_cast<size_t>(PLANES) * _planeWords; }
+
+        /// one byte (0 or 1) per plane and cell, planes in Plane order
+        void encode(uint8_t* out) const;
+        /// one bit per plane and cell
+        void encodePacked(uint64_t* out) const;
+    private:
+        template <class F> void dynamicCells(F&& f) const;
+
+        int _cols = 0;
+        int _rows = 0;
+        float _cell = 1;
+        size_t _planeWords = 0;
+        std::vector<uint8_t> _walls;
+        std::vector<uint64_t> _packedWalls;
+    };
+} // namespace pacman
@@ -0,0 +1,79 @@
+#include "VecEnv.h"
+
+namespace pacman
+{
+    /**
+     * @brief Builds n environments, each on an empty World, and parks them.
+     */
+    VecEnv::VecEnv(int n)
+        : _worlds(n), _rewards(n), _dones(n), _last(n)
+    {
+        for (int i = 0; i < n; ++i) {
+            PacMan::clearWorld();
+            _envs.push_back(std::make_unique<PacMan>(i, true));
+            _envs[i]->suspend(_worlds[i]);
+        }
+        _obsSize = n > 0 ? _envs[0]->encoder().size() : 0;
+        _obs.assign(n * _obsSize, 0);
+    }
+
+    /**
+     * @brief Swaps environment i's entities into the World, parking the current one.
+     */
+    void VecEnv::activate(int i)
+    {
+        if (_active == i)
+            return;
+        if (_active >= 0)
+            _envs[_active]->suspend(_worlds[_active]);
+        _envs[i]->resume(_worlds[i]);
+        _active = i;
+    }
+
+    void VecEnv::restart(int i)
+    {
+        _envs[i]->restart();
+        _last[i] = *_envs[i]->stats();
+    }
+
+    void VecEnv::reset(const uint64_t* seeds)
+    {
+        for (int i = 0; i < size(); ++i) {
+            activate(i);
+            restart(i);
+            World::resource<Rng>().seed(seeds[i]);
+            _rewards[i] = 0;
+            _dones[i] = 0;
+            observe(i);
+        }
+    }
+
+    /**
+     * @brief The reward is the score gained this tick. A new life starts a new score, so after a
+     * death the respawned player's score counts in full.
+     */
+    void VecEnv::step(const uint8_t* actions)
+    {
+        for (int i = 0; i < size(); ++i) {
+            activate(i);
+            _envs[i]->step(static_cast<eDir>(actions[i]));
+
+            const PlayerStats* stats = _envs[i]->stats();
+            _dones[i] = stats == nullptr;
+            if (stats == nullptr) {
+                _rewards[i] = 0;
+                restart(i);
+            }
+            else {
+                _rewards[i] = static_cast<float>(stats->lives < _last[i].lives ? stats->score : stats->score - _last[i].score);
+                _last[i] = *stats;
+            }
+            observe(i);
+        }
+    }
+
+    void VecEnv::observe(int i)
+    {
+        _envs[i]->encoder().encode(&_obs[i * _obsSize]);
+    }
+} // namespace pacman
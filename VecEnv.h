@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Pacman.h"
+/**
+ * @file VecEnv.h
+ * @brief Vectorized, Gym-style training environment over headless PacMan instances.
+ *
+ * Every environment is its own PacMan with its own Box2D world. bagel has a single global World,
+ * so the environments take turns: the active one's entities are in the World and the others are
+ * parked in snapshots (a bulk copy each way). Observations are TileEncoder planes. Results land in
+ * contiguous buffers that are allocated once, so step() allocates nothing.
+ */
+
+namespace pacman {
+
+    class VecEnv {
+    public:
+        explicit VecEnv(int n);
+
+        /// restarts every environment; seeds (one per environment) reseed their Rng
+        void reset(const uint64_t* seeds);
+        /**
+         * @brief Advances every environment by one tick.
+         * @param actions One eDir per environment; None keeps the current heading.
+         * An environment whose game ends reports done and is restarted in the same call.
+         */
+        void step(const uint8_t* actions);
+
+        int size() const { return static_cast<int>(_envs.size()); }
+        /// bytes of one environment's observation (TileEncoder::size())
+        size_t observationSize() const { return _obsSize; }
+        const uint8_t* observations() const { return _obs.data(); }
+        const float* rewards() const { return _rewards.data(); }
+        const uint8_t* dones() const { return _dones.data(); }
+    private:
+        void activate(int i);
+        void observe(int i);
+        void restart(int i);
+
+        std::vector<std::unique_ptr<PacMan>> _envs;
+        std::vector<Snapshot> _worlds;
+        int _active = -1;
+
+        size_t _obsSize = 0;
+        std::vector<uint8_t> _obs;
+        std::vector<float> _rewards;
+        std::vector<uint8_t> _dones;
+        std::vector<PlayerStats> _last;
+    };
+} // namespace pacman
@@ -2,12 +2,33 @@
 
 #pragma once
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <new>
+#include <memory>
 #include <algorithm>
 #include <type_traits>
+#include <iterator>
+#include <atomic>
+#if defined(__SSE2__)
+	#include <immintrin.h>
+#endif
+#if defined(__linux__)
+	#include <sys/mman.h>
+#endif
+
+// first pass over the config: forward declarations of the registered components, at global scope
+#if __has_include("bagel_cfg.h")
+	#define BAGEL_DECLARE
+	#include "bagel_cfg.h"
+	#undef BAGEL_DECLARE
+#endif
 
 namespace bagel
 {
+	// where the growable bags get their memory; see MallocAlloc and the classes after it
+	enum class AllocPolicy { Malloc, Arena, Pool, HugePages };
+
 	struct Bagel
 	{
 		bool	AggregateUpdates = true;
@@ -17,19 +38,29 @@ namespace bagel
 		int		InitialEntities = 1000;
 		int		InitialPackedSize = 5;
 		int		MaxComponents = 10;
+		int		SparsePageSize = 256;
+		int		IdBlockSize = 64;
+		AllocPolicy	Allocator = AllocPolicy::Malloc;
 	};
 
 	template <class T> struct Storage;
 	template <class T> class PackedStorage;
 	template <class T> class SparseStorage;
 	template <class T> class TaggedStorage;
+	template <class T> class BitPackedStorage;
+	template <class T> class SplitStorage;
+
+	template <class ...Ts> struct ComponentList {};
 
 #if __has_include("bagel_cfg.h")
 	#define BAGEL_STORAGE(C,T) template <> struct Storage<C> { using type = T<C>; };
+	#define BAGEL_COMPONENTS(...) using Components = ComponentList<__VA_ARGS__>;
 	#include "bagel_cfg.h"
+	#undef BAGEL_COMPONENTS
 	#undef BAGEL_STORAGE
 #else
 	constexpr Bagel Params{};
+	using Components = ComponentList<>;
 #endif
 
 	using id_type = int;
@@ -50,52 +81,331 @@ namespace bagel
 		void operator=(const NoCopy&) = delete;
 	};
 
-	template <class T, int N>
+	// T(args...) when T has such a constructor, else aggregate initialization T{args...}
+	template <class T, class ...Args>
+	T make(Args&&... args) {
+		if constexpr (std::is_constructible_v<T, Args...>)
+			return T(std::forward<Args>(args)...);
+		else
+			return T{std::forward<Args>(args)...};
+	}
+
+	// memory held by a bag or storage, and how many times it went to its allocator
+	struct AllocStats {
+		std::size_t	allocations = 0;
+		std::size_t	bytes = 0;
+
+		AllocStats& operator+=(const AllocStats& o) {
+			allocations += o.allocations;
+			bytes += o.bytes;
+			return *this;
+		}
+	};
+
+	// allocators are static: allocate(bytes), reallocate(p, oldBytes, bytes), deallocate(p, bytes);
+	// none of them is thread-safe
+	struct MallocAlloc final : NoInstance {
+		static void* allocate(std::size_t bytes) { return malloc(bytes); }
+		static void* reallocate(void* p, std::size_t, std::size_t bytes) { return realloc(p, bytes); }
+		static void deallocate(void* p, std::size_t) { free(p); }
+	};
+
+	// bump allocation from large chunks; frees are no-ops and every chunk is released in one go by
+	// reset(), which World::release() calls when a world is torn down. Growing the last block is in
+	// place, anything else copies
+	class ArenaAlloc final : NoInstance
+	{
+	public:
+		static constexpr std::size_t ChunkSize = 1 << 20;
+
+		static void* allocate(std::size_t bytes) {
+			bytes = round(bytes);
+			if (_arena.head == nullptr || _arena.used + bytes > _arena.head->size)
+				chunk(bytes);
+			void* p = _arena.head->data() + _arena.used;
+			_arena.used += bytes;
+			_arena.last = p;
+			return p;
+		}
+		static void* reallocate(void* p, std::size_t old, std::size_t bytes) {
+			if (p != nullptr && p == _arena.last &&
+				static_cast<char*>(p) - _arena.head->data() + round(bytes) <= _arena.head->size) {
+				_arena.used = static_cast<char*>(p) - _arena.head->data() + round(bytes);
+				return p;
+			}
+			void* q = allocate(bytes);
+			if (p != nullptr)
+				memcpy(q, p, std::min(old, bytes));
+			return q;
+		}
+		static void deallocate(void*, std::size_t) {}
+
+		// frees every chunk; nothing allocated before may be used afterwards
+		static void reset() { _arena.release(); }
+		// bytes held in chunks
+		static std::size_t held() {
+			std::size_t bytes = 0;
+			for (Chunk* c = _arena.head; c != nullptr; c = c->next)
+				bytes += c->size;
+			return bytes;
+		}
+	private:
+		struct alignas(16) Chunk {
+			Chunk*		next;
+			std::size_t	size;
+			char* data() { return reinterpret_cast<char*>(this + 1); }
+		};
+		// a zero-initialized aggregate that is never destroyed, so storages in any TU may use it
+		// during their own static init and destruction; chunks still held at exit go to the OS
+		struct Arena {
+			Chunk*		head;
+			std::size_t	used;
+			void*		last;
+			void release() {
+				while (head != nullptr) {
+					Chunk* next = head->next;
+					free(head);
+					head = next;
+				}
+				used = 0;
+				last = nullptr;
+			}
+		};
+
+		static std::size_t round(std::size_t bytes) { return (bytes + 15) & ~std::size_t{15}; }
+		static void chunk(std::size_t bytes) {
+			const std::size_t size = std::max(bytes, ChunkSize);
+			auto* c = static_cast<Chunk*>(malloc(sizeof(Chunk) + size));
+			*c = Chunk{_arena.head, size};
+			_arena.head = c;
+			_arena.used = 0;
+		}
+
+		static inline Arena _arena{};
+	};
+
+	// power-of-two block classes from 64 B to 1 MB with a free list each, so memory given back by one
+	// bag (or one world) is reused by the next; larger requests go to malloc
+	class PoolAlloc final : NoInstance
+	{
+	public:
+		static void* allocate(std::size_t bytes) {
+			const int c = sizeClass(bytes);
+			if (c < 0)
+				return malloc(bytes);
+			if (Block* b = _pool.free[c]) {
+				_pool.free[c] = b->next;
+				return b;
+			}
+			return malloc(MinBlock << c);
+		}
+		static void* reallocate(void* p, std::size_t old, std::size_t bytes) {
+			if (p == nullptr)
+				return allocate(bytes);
+			const int from = sizeClass(old);
+			const int to = sizeClass(bytes);
+			if (from < 0 && to < 0)
+				return realloc(p, bytes);
+			if (from >= 0 && from == to)
+				return p;
+			void* q = allocate(bytes);
+			memcpy(q, p, std::min(old, bytes));
+			deallocate(p, old);
+			return q;
+		}
+		static void deallocate(void* p, std::size_t bytes) {
+			const int c = sizeClass(bytes);
+			if (p == nullptr)
+				return;
+			if (c < 0) {
+				free(p);
+				return;
+			}
+			auto* b = static_cast<Block*>(p);
+			b->next = _pool.free[c];
+			_pool.free[c] = b;
+		}
+	private:
+		static constexpr std::size_t MinBlock = 64;
+		static constexpr int Classes = 15;	// up to 64 B << 14 = 1 MB
+
+		struct Block { Block* next; };
+		// zero-initialized and never destroyed, like ArenaAlloc's state; blocks still on a free
+		// list at exit are left to the OS
+		struct Pool {
+			Block* free[Classes];
+		};
+
+		static int sizeClass(std::size_t bytes) {
+			int c = 0;
+			while ((MinBlock << c) < bytes)
+				if (++c == Classes)
+					return -1;
+			return c;
+		}
+
+		static inline Pool _pool{};
+	};
+
+	// buffers of 2 MB and up are anonymous mappings advised for transparent huge pages, and grow with
+	// mremap; smaller ones, and every buffer off Linux, go to malloc
+	class HugePageAlloc final : NoInstance
+	{
+	public:
+		static constexpr std::size_t HugePage = 2 << 20;
+
+		static void* allocate(std::size_t bytes) {
+#if defined(__linux__)
+			if (bytes >= HugePage) {
+				void* p = mmap(nullptr, round(bytes), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (p == MAP_FAILED)
+					return nullptr;
+				madvise(p, round(bytes), MADV_HUGEPAGE);
+				return p;
+			}
+#endif
+			return malloc(bytes);
+		}
+		static void* reallocate(void* p, std::size_t old, std::size_t bytes) {
+#if defined(__linux__)
+			if (p != nullptr && old >= HugePage) {
+				if (bytes <= round(old))
+					return p;
+				void* q = mremap(p, round(old), round(bytes), MREMAP_MAYMOVE);
+				if (q == MAP_FAILED)
+					return nullptr;
+				madvise(q, round(bytes), MADV_HUGEPAGE);
+				return q;
+			}
+			if (bytes >= HugePage) {
+				void* q = allocate(bytes);
+				if (p != nullptr)
+					memcpy(q, p, old);
+				free(p);
+				return q;
+			}
+#endif
+			return realloc(p, bytes);
+		}
+		static void deallocate(void* p, std::size_t bytes) {
+#if defined(__linux__)
+			if (p != nullptr && bytes >= HugePage) {
+				munmap(p, round(bytes));
+				return;
+			}
+#endif
+			free(p);
+		}
+	private:
+		static std::size_t round(std::size_t bytes) { return (bytes + HugePage - 1) / HugePage * HugePage; }
+	};
+
+	using DefaultAlloc =
+		std::conditional_t<Params.Allocator == AllocPolicy::Arena, ArenaAlloc,
+		std::conditional_t<Params.Allocator == AllocPolicy::Pool, PoolAlloc,
+		std::conditional_t<Params.Allocator == AllocPolicy::HugePages, HugePageAlloc,
+			MallocAlloc>>>;
+
+	template <class T, int N, class A = DefaultAlloc>
 	class DynamicBag : NoCopy
 	{
 	public:
-		void push(const T& t) {
+		// constructs in place; trivially copyable types still grow with a plain reallocate
+		template <class ...Args>
+		T& emplace(Args&&... args) {
 			if (_size == _capacity) {
-				_capacity *= 2;
-				_arr = static_cast<T*>(
-					realloc(_arr, sizeof(T)*_capacity));
+				// args may refer into _arr, so build the element before growing
+				T t = make<T>(std::forward<Args>(args)...);
+				grow(std::max(N, _capacity*2));
+				return *new (_arr + _size++) T(std::move(t));
 			}
-			_arr[_size] = t;
+			T* t = new (_arr + _size) T(make<T>(std::forward<Args>(args)...));
 			++_size;
+			return *t;
 		}
+		void push(const T& t) { emplace(t); }
+		void push(T&& t) { emplace(std::move(t)); }
 		void ensure(size_type s) {
-			if (_capacity < s) {
-				_capacity = std::max(s, _capacity*2);
-				_arr = static_cast<T*>(
-					realloc(_arr, sizeof(T)*_capacity));
-			}
+			if (_capacity < s)
+				grow(std::max(s, _capacity*2));
+		}
+		T pop() {
+			T t = std::move(_arr[--_size]);
+			_arr[_size].~T();
+			return t;
 		}
-		T pop() { return _arr[--_size]; }
 		T& operator[](index_type i) { return _arr[i]; }
 		const T& operator[](index_type i) const { return _arr[i]; }
-		void clear() { _size = 0; }
+		void clear() {
+			std::destroy_n(_arr, _size);
+			_size = 0;
+		}
+		// new elements are left uninitialized when T is trivial, value-initialized otherwise
+		void resize(size_type s) {
+			ensure(s);
+			if constexpr (!std::is_trivial_v<T>) {
+				if (s > _size)
+					std::uninitialized_value_construct(_arr + _size, _arr + s);
+				else
+					std::destroy(_arr + s, _arr + _size);
+			}
+			_size = s;
+		}
 
+		T* data() { return _arr; }
+		const T* data() const { return _arr; }
 		size_type size() const { return _size; }
 		size_type capacity() const { return _capacity; }
+		AllocStats stats() const { return {_allocations, sizeof(T)*_capacity}; }
 
-		~DynamicBag() { free(_arr); }
+		// empties the bag and gives back its buffer; the next push allocates again
+		void release() {
+			std::destroy_n(_arr, _size);
+			A::deallocate(_arr, sizeof(T)*_capacity);
+			_arr = nullptr;
+			_size = _capacity = 0;
+		}
+		~DynamicBag() { release(); }
 	private:
-		T*			_arr = static_cast<T*>(malloc(sizeof(T) * N));
+		void grow(size_type capacity) {
+			if constexpr (std::is_trivially_copyable_v<T>)
+				_arr = static_cast<T*>(A::reallocate(_arr, sizeof(T)*_capacity, sizeof(T)*capacity));
+			else {
+				T* arr = static_cast<T*>(A::allocate(sizeof(T)*capacity));
+				std::uninitialized_move_n(_arr, _size, arr);
+				std::destroy_n(_arr, _size);
+				A::deallocate(_arr, sizeof(T)*_capacity);
+				_arr = arr;
+			}
+			_capacity = capacity;
+			++_allocations;
+		}
+
+		T*			_arr = static_cast<T*>(A::allocate(sizeof(T) * N));
 		size_type	_size = 0;
 		size_type	_capacity = N;
+		std::size_t	_allocations = 1;
 	};
 	template <class T, int N>
 	class StaticBag
 	{
 	public:
+		template <class ...Args>
+		T& emplace(Args&&... args) { return _arr[_size++] = make<T>(std::forward<Args>(args)...); }
 		void push(const T& t) { _arr[_size++] = t; }
-		T pop() { return _arr[--_size]; }
+		void push(T&& t) { _arr[_size++] = std::move(t); }
+		T pop() { return std::move(_arr[--_size]); }
 		T& operator[](index_type i) { return _arr[i]; }
 		const T& operator[](index_type i) const { return _arr[i]; }
 		void clear() { _size = 0; }
+		void resize(size_type s) { _size = s; }
+		void release() { _size = 0; }
 
+		T* data() { return _arr; }
+		const T* data() const { return _arr; }
 		size_type size() const { return _size; }
 		static constexpr size_type capacity() { return N; }
+		static AllocStats stats() { return {0, sizeof(T)*N}; }
 		static void ensure(size_type) {}
 	private:
 		T			_arr[N];
@@ -104,43 +414,223 @@ namespace bagel
 	template <class T, int N>
 	using Bag = std::conditional_t<Params.DynamicResize, DynamicBag<T, N>, StaticBag<T,N>>;
 
+	class Snapshot;
+
+	// entity-indexed array in fixed-size pages allocated on first write; every other page is one
+	// shared zeroed page, so memory follows the ids actually written rather than the largest id
+	template <class T, int PageSize = Params.SparsePageSize, class A = DefaultAlloc>
+	class PagedBag : NoCopy
+	{
+	public:
+		// reads of pages never written see T{}; writes go through slot(), so the shared page stays zero
+		const T& operator[](index_type i) const { return page(i / PageSize)[i % PageSize]; }
+
+		// element i, allocating its page
+		T& slot(index_type i) {
+			const index_type p = i / PageSize;
+			if (p >= _count)
+				grow(p + 1);
+			if (_pages[p] == _null) {
+				_pages[p] = static_cast<T*>(A::allocate(sizeof(T) * PageSize));
+				std::uninitialized_value_construct_n(_pages[p], PageSize);
+				++_allocated;
+				++_allocations;
+			}
+			return _pages[p][i % PageSize];
+		}
+		void reserve(size_type n) {
+			if (n > 0 && (n - 1) / PageSize >= _count)
+				grow((n - 1) / PageSize + 1);
+		}
+		size_type pages() const { return _allocated; }
+		AllocStats stats() const {
+			return {_allocations, sizeof(T)*PageSize*_allocated + sizeof(T*)*_count};
+		}
+
+		// ids [0,n): a flag per page, then the contents of written pages only
+		void save(Snapshot& s, size_type n) const;
+		void load(const Snapshot& s, size_type& at, size_type n);
+
+		// gives back every page and the page directory
+		void release() {
+			for (index_type p = 0; p < _count; ++p)
+				if (_pages[p] != _null) {
+					std::destroy_n(_pages[p], PageSize);
+					A::deallocate(_pages[p], sizeof(T) * PageSize);
+				}
+			A::deallocate(_pages, sizeof(T*) * _count);
+			_pages = nullptr;
+			_count = 0;
+			_allocated = 0;
+		}
+		~PagedBag() { release(); }
+	private:
+		T* page(index_type p) const { return p < _count ? _pages[p] : _null; }
+		void grow(size_type count) {
+			_pages = static_cast<T**>(A::reallocate(_pages, sizeof(T*) * _count, sizeof(T*) * count));
+			++_allocations;
+			for (index_type p = _count; p < count; ++p)
+				_pages[p] = _null;
+			_count = count;
+		}
+
+		static inline T	_null[PageSize] = {};
+		T**				_pages = nullptr;
+		size_type		_count = 0;
+		size_type		_allocated = 0;
+		std::size_t		_allocations = 0;
+	};
+
+	// byte image of the world; the buffer is kept, so retaking a snapshot does not allocate
+	class Snapshot
+	{
+	public:
+		Snapshot() = default;
+		Snapshot(const Snapshot&) = delete;
+		void operator=(const Snapshot&) = delete;
+		Snapshot(Snapshot&& o) noexcept
+			: _data(o._data), _size(o._size), _capacity(o._capacity) {
+			o._data = nullptr;
+			o._size = o._capacity = 0;
+		}
+		Snapshot& operator=(Snapshot&& o) noexcept {
+			std::swap(_data, o._data);
+			std::swap(_size, o._size);
+			std::swap(_capacity, o._capacity);
+			return *this;
+		}
+		~Snapshot() { free(_data); }
+
+		void write(const void* src, size_type bytes) {
+			if (_size + bytes > _capacity) {
+				_capacity = std::max(_size + bytes, _capacity*2);
+				_data = static_cast<char*>(realloc(_data, _capacity));
+			}
+			memcpy(_data + _size, src, bytes);
+			_size += bytes;
+		}
+		void read(size_type& at, void* dst, size_type bytes) const {
+			memcpy(dst, _data + at, bytes);
+			at += bytes;
+		}
+		void clear() { _size = 0; }
+		size_type size() const { return _size; }
+	private:
+		char*		_data = nullptr;
+		size_type	_size = 0;
+		size_type	_capacity = 0;
+	};
+
+	template <class T, int PageSize, class A>
+	void PagedBag<T, PageSize, A>::save(Snapshot& s, size_type n) const {
+		for (index_type p = 0; p * PageSize < n; ++p) {
+			const bool written = page(p) != _null;
+			s.write(&written, sizeof(written));
+			if (written)
+				s.write(_pages[p], sizeof(T) * PageSize);
+		}
+	}
+	template <class T, int PageSize, class A>
+	void PagedBag<T, PageSize, A>::load(const Snapshot& s, size_type& at, size_type n) {
+		for (index_type p = 0; p * PageSize < n; ++p) {
+			bool written;
+			s.read(at, &written, sizeof(written));
+			if (written)
+				s.read(at, &slot(p * PageSize), sizeof(T) * PageSize);
+		}
+	}
+
 	struct StorageCallbacks
 	{
 		using Destroy = void (*)(ent_type);
 		Destroy destroy = nullptr;
 	};
-	template <class> class StorageRegister;
+
+	// specialize with any of static onAdd(ent_type), onRemove(ent_type), onUpdate(ent_type);
+	// hooks run with the component still readable, and unobserved types compile to no dispatch at all
+	template <class T> struct Observer {};
+
+	template <class T, class = void> constexpr bool ObservesAdd = false;
+	template <class T> constexpr bool ObservesAdd<T,
+		std::void_t<decltype(Observer<T>::onAdd(ent_type{}))>> = true;
+	template <class T, class = void> constexpr bool ObservesRemove = false;
+	template <class T> constexpr bool ObservesRemove<T,
+		std::void_t<decltype(Observer<T>::onRemove(ent_type{}))>> = true;
+	template <class T, class = void> constexpr bool ObservesUpdate = false;
+	template <class T> constexpr bool ObservesUpdate<T,
+		std::void_t<decltype(Observer<T>::onUpdate(ent_type{}))>> = true;
+
+	// specialize to std::true_type to keep a per-entity tick of the last mutable access to T
+	template <class T> struct TrackChanges : std::false_type {};
+	template <class T>
+	struct ChangeTicks final : NoInstance {
+		static inline PagedBag<std::uint32_t> ticks;
+	};
+
+	// query filter: has T, and T changed since the given tick
+	template <class T> struct Changed {};
+	template <class T> struct FilterTraits { using type = T; static constexpr bool changed = false; };
+	template <class T> struct FilterTraits<Changed<T>> { using type = T; static constexpr bool changed = true; };
+
+	// owning group: specialize Owner<T>::type = Group<...> for each T of the group (all PackedStorage);
+	// a type can be owned by a single group
+	template <class ...Ts> class Group;
+	template <class T> struct Owner { using type = void; };
+	template <class T> constexpr bool Owned = !std::is_void_v<typename Owner<T>::type>;
 
 	template <class T>
 	class SparseStorage final : NoInstance
 	{
 	public:
-		static void add(ent_type e, const T& t) {
-			_bag.ensure(e.id);
-			_bag[e.id] = t;
+		template <class ...Args>
+		static void emplace(ent_type e, Args&&... args) {
+			_bag.slot(e.id) = make<T>(std::forward<Args>(args)...);
+		}
+		// resets the slot so that a non-trivial component releases what it holds
+		static void del(ent_type e) {
+			if constexpr (!std::is_trivially_destructible_v<T>)
+				_bag.slot(e.id) = T{};
+		}
+		static T& get(ent_type e) { return _bag.slot(e.id); }
+		static void move(ent_type from, ent_type to) {
+			_bag.slot(to.id) = std::move(_bag.slot(from.id));
+			del(from);
+		}
+		static void reserve(size_type n, size_type) { _bag.reserve(n); }
+		static AllocStats stats() { return _bag.stats(); }
+		static void clear() {}
+		static void release() { _bag.release(); }
+
+		static void save(Snapshot& s, size_type n) {
+			static_assert(std::is_trivially_copyable_v<T>, "snapshots copy components bytewise");
+			_bag.save(s, n);
+		}
+		static void load(const Snapshot& s, size_type& at, size_type n) {
+			_bag.load(s, at, n);
 		}
-		static void del(ent_type) {}
-		static T& get(ent_type e) { return _bag[e.id]; }
 	private:
-		static inline Bag<T,Params.InitialEntities> _bag;
+		static inline PagedBag<T> _bag;
 	};
 	template <class T>
 	class PackedStorage final : NoInstance
 	{
 	public:
-		static void add(ent_type e, const T& t) {
-			_entToComp.ensure(e.id);
-			_entToComp[e.id] = _comps.size();
-			_comps.push(t);
+		template <class ...Args>
+		static void emplace(ent_type e, Args&&... args) {
+			_entToComp.slot(e.id) = _comps.size();
+			_comps.emplace(std::forward<Args>(args)...);
 			_compToEnt.push(e);
 		}
 		static void del(ent_type e) {
 			index_type ent_comp_idx = _entToComp[e.id];
+			index_type last = _comps.size()-1;
 			ent_type last_ent = _compToEnt.pop();
 
-			_comps[ent_comp_idx] = _comps.pop();
+			if (ent_comp_idx != last)
+				_comps[ent_comp_idx] = std::move(_comps[last]);
+			_comps.pop();
 			_compToEnt[ent_comp_idx] = last_ent;
-			_entToComp[last_ent.id] = ent_comp_idx;
+			_entToComp.slot(last_ent.id) = ent_comp_idx;
 		}
 		static T& get(ent_type e) {
 			return _comps[_entToComp[e.id]];
@@ -152,23 +642,341 @@ namespace bagel
 		static ent_type entity(index_type idx) {
 			return _compToEnt[idx];
 		}
+		static index_type index(ent_type e) {
+			return _entToComp[e.id];
+		}
+		// renames the owner of e's component; its place in the array is kept
+		static void move(ent_type from, ent_type to) {
+			const index_type idx = _entToComp[from.id];
+			_entToComp.slot(to.id) = idx;
+			_compToEnt[idx] = to;
+		}
+		// ids [0,n), and room for extra components beyond those already held
+		static void reserve(size_type n, size_type extra) {
+			_entToComp.reserve(n);
+			_comps.ensure(_comps.size() + extra);
+			_compToEnt.ensure(_compToEnt.size() + extra);
+		}
+		static AllocStats stats() {
+			AllocStats st = _comps.stats();
+			st += _compToEnt.stats();
+			st += _entToComp.stats();
+			return st;
+		}
+		static void clear() {
+			_comps.clear();
+			_compToEnt.clear();
+			_grouped = 0;
+		}
+		static void release() {
+			clear();
+			_comps.release();
+			_compToEnt.release();
+			_entToComp.release();
+		}
+
+		static void save(Snapshot& s, size_type n) {
+			static_assert(std::is_trivially_copyable_v<T>, "snapshots copy components bytewise");
+			const size_type size = _comps.size();
+			s.write(&size, sizeof(size));
+			s.write(&_grouped, sizeof(_grouped));
+			s.write(_comps.data(), sizeof(T)*size);
+			s.write(_compToEnt.data(), sizeof(ent_type)*size);
+			_entToComp.save(s, n);
+		}
+		static void load(const Snapshot& s, size_type& at, size_type n) {
+			size_type size;
+			s.read(at, &size, sizeof(size));
+			s.read(at, &_grouped, sizeof(_grouped));
+			_comps.resize(size);
+			_compToEnt.resize(size);
+			s.read(at, _comps.data(), sizeof(T)*size);
+			s.read(at, _compToEnt.data(), sizeof(ent_type)*size);
+			_entToComp.load(s, at, n);
+		}
 	private:
-		static inline Bag<T,Params.InitialPackedSize>			_comps;
-		static inline Bag<index_type,Params.InitialEntities>	_entToComp;
-		static inline Bag<ent_type,Params.InitialPackedSize>	_compToEnt;
+		template <class...> friend class Group;
 
-		static inline StorageCallbacks callbacks{del};
+		static void swap(index_type a, index_type b) {
+			if (a == b)
+				return;
+			std::swap(_comps[a], _comps[b]);
+			std::swap(_compToEnt[a], _compToEnt[b]);
+			_entToComp.slot(_compToEnt[a].id) = a;
+			_entToComp.slot(_compToEnt[b].id) = b;
+		}
 
-		__attribute__((used))
-		static inline StorageRegister<T> reg{callbacks};
+		static inline Bag<T,Params.InitialPackedSize>			_comps;
+		static inline PagedBag<index_type>						_entToComp;
+		static inline Bag<ent_type,Params.InitialPackedSize>	_compToEnt;
+		// entries [0,_grouped) belong to T's owning group
+		static inline size_type									_grouped = 0;
 	};
 	template <class T>
 	class TaggedStorage final : NoInstance
 	{
 	public:
-		static void add(ent_type, const T&) {}
+		template <class ...Args>
+		static void emplace(ent_type, Args&&...) {}
 		static void del(ent_type) {}
 		static T& get(ent_type) = delete;
+		static void move(ent_type, ent_type) {}
+		static void reserve(size_type, size_type) {}
+		static AllocStats stats() { return {}; }
+		static void clear() {}
+		static void release() {}
+		static void save(Snapshot&, size_type) {}
+		static void load(const Snapshot&, size_type&, size_type) {}
+	};
+	// flag components, structs of bool fields only, kept as bit planes: each run of 64 ids owns one
+	// word per field plus one marking which of them have T, so a field of 64 entities is one word.
+	// get() returns a Ref proxy; read it whole as a T or one field through ref[&T::field].
+	template <class T>
+	class BitPackedStorage final : NoInstance
+	{
+		static_assert(std::is_trivially_copyable_v<T> && std::has_unique_object_representations_v<T>,
+			"every byte of a bit-packed component is a bool field");
+		using word_type = std::uint64_t;
+		static constexpr size_type WordBits = 64;
+		static constexpr size_type Fields = sizeof(T);
+		static constexpr size_type Planes = Fields + 1;
+	public:
+		class Bit
+		{
+		public:
+			operator bool() const { return (*_word & _mask) != 0; }
+			const Bit& operator=(bool v) const {
+				*_word = v ? *_word | _mask : *_word & ~_mask;
+				return *this;
+			}
+		private:
+			friend BitPackedStorage;
+			Bit(word_type* word, word_type mask) : _word(word), _mask(mask) {}
+			word_type*	_word;
+			word_type	_mask;
+		};
+		class Ref
+		{
+		public:
+			operator T() const { return gather(_id); }
+			const Ref& operator=(const T& t) const {
+				scatter(_id, t);
+				return *this;
+			}
+			Bit operator[](bool T::* f) const {
+				return {&_bits.slot(word(_id, field(f))), word_type{1} << _id % WordBits};
+			}
+		private:
+			friend BitPackedStorage;
+			explicit Ref(id_type id) : _id(id) {}
+			id_type _id;
+		};
+
+		template <class ...Args>
+		static void emplace(ent_type e, Args&&... args) {
+			scatter(e.id, make<T>(std::forward<Args>(args)...));
+			_bits.slot(word(e.id, Fields)) |= word_type{1} << e.id % WordBits;
+			_blocks = std::max(_blocks, e.id / WordBits + 1);
+		}
+		static void del(ent_type e) {
+			scatter(e.id, T{});
+			_bits.slot(word(e.id, Fields)) &= ~(word_type{1} << e.id % WordBits);
+		}
+		static Ref get(ent_type e) { return Ref(e.id); }
+		static void move(ent_type from, ent_type to) {
+			const T t = gather(from.id);
+			del(from);
+			emplace(to, t);
+		}
+
+		// field f of every entity that has T, a word at a time
+		static void fill(bool T::* f, bool v) {
+			const size_type at = field(f);
+			for (index_type b = 0; b < _blocks; ++b) {
+				const word_type has = _bits[b*Planes + Fields];
+				if (has)
+					_bits.slot(b*Planes + at) = v ? has : 0;
+			}
+		}
+		static size_type count(bool T::* f) {
+			const size_type at = field(f);
+			size_type n = 0;
+			for (index_type b = 0; b < _blocks; ++b)
+				n += __builtin_popcountll(_bits[b*Planes + at]);
+			return n;
+		}
+
+		static void reserve(size_type n, size_type) { _bits.reserve(words(n)); }
+		static AllocStats stats() { return _bits.stats(); }
+		static void clear() {
+			for (index_type i = 0; i < _blocks*Planes; ++i)
+				if (_bits[i])
+					_bits.slot(i) = 0;
+			_blocks = 0;
+		}
+		static void release() {
+			_bits.release();
+			_blocks = 0;
+		}
+
+		static void save(Snapshot& s, size_type n) { _bits.save(s, words(n)); }
+		static void load(const Snapshot& s, size_type& at, size_type n) {
+			clear();
+			_bits.load(s, at, words(n));
+			_blocks = words(n) / Planes;
+		}
+	private:
+		static constexpr size_type words(size_type n) { return (n + WordBits - 1) / WordBits * Planes; }
+		static constexpr index_type word(id_type id, size_type f) { return id / WordBits * Planes + f; }
+		static size_type field(bool T::* f) {
+			static const T probe{};
+			return reinterpret_cast<const char*>(&(probe.*f)) - reinterpret_cast<const char*>(&probe);
+		}
+
+		static T gather(id_type id) {
+			char bytes[Fields];
+			for (size_type f = 0; f < Fields; ++f)
+				bytes[f] = (_bits[word(id, f)] >> id % WordBits) & 1;
+			T t;
+			std::memcpy(&t, bytes, Fields);
+			return t;
+		}
+		static void scatter(id_type id, const T& t) {
+			char bytes[Fields];
+			std::memcpy(bytes, &t, Fields);
+			const word_type bit = word_type{1} << id % WordBits;
+			for (size_type f = 0; f < Fields; ++f) {
+				word_type& w = _bits.slot(word(id, f));
+				w = bytes[f] ? w | bit : w & ~bit;
+			}
+		}
+
+		static inline PagedBag<word_type>	_bits;
+		static inline size_type				_blocks = 0;
+	};
+
+
+	// copies arrays element by element
+	template <class M>
+	void assignField(M& dst, const M& src) {
+		if constexpr (std::is_array_v<M>)
+			std::copy(std::begin(src), std::end(src), std::begin(dst));
+		else
+			dst = src;
+	}
+	// one field of a split component as a packed array; fields are boxed so that arrays can be pushed
+	template <class M>
+	class Column : NoCopy
+	{
+		struct Box { M v; };
+	public:
+		M& operator[](index_type i) { return _bag[i].v; }
+		const M& operator[](index_type i) const { return _bag[i].v; }
+		void push(const M& m) {
+			_bag.push(Box{});
+			assignField(_bag[_bag.size()-1].v, m);
+		}
+		void pop() { _bag.pop(); }
+		void swap(index_type a, index_type b) { std::swap(_bag[a], _bag[b]); }
+		size_type size() const { return _bag.size(); }
+		void ensure(size_type n) { _bag.ensure(n); }
+		void clear() { _bag.clear(); }
+		void release() { _bag.release(); }
+		AllocStats stats() const { return _bag.stats(); }
+		void save(Snapshot& s) const { s.write(_bag.data(), sizeof(Box)*_bag.size()); }
+		void load(const Snapshot& s, size_type& at, size_type n) {
+			_bag.resize(n);
+			s.read(at, _bag.data(), sizeof(Box)*n);
+		}
+	private:
+		Bag<Box,Params.InitialPackedSize> _bag;
+	};
+
+	// the columns and proxy of a split component, generated by BAGEL_SPLIT
+	template <class T> struct SplitFields;
+
+	// a struct component stored one packed Column per field, so a loop over one field walks only
+	// that field; get() returns the SplitFields<T>::Ref proxy with a reference member per field
+	template <class T>
+	class SplitStorage final : NoInstance
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "split components are copied field by field");
+	public:
+		using Columns = typename SplitFields<T>::Columns;
+		using Ref = typename SplitFields<T>::Ref;
+
+		template <class ...Args>
+		static void emplace(ent_type e, Args&&... args) {
+			_entToComp.slot(e.id) = size();
+			_cols.push(make<T>(std::forward<Args>(args)...));
+			_compToEnt.push(e);
+		}
+		static void del(ent_type e) {
+			const index_type idx = _entToComp[e.id];
+			const index_type last = size()-1;
+			const ent_type last_ent = _compToEnt.pop();
+
+			_cols.each([=](auto& c) {
+				c.swap(idx, last);
+				c.pop();
+			});
+			_compToEnt[idx] = last_ent;
+			_entToComp.slot(last_ent.id) = idx;
+		}
+		static Ref get(ent_type e) { return _cols.ref(_entToComp[e.id]); }
+		static Ref get(index_type idx) { return _cols.ref(idx); }
+		static int size() { return _compToEnt.size(); }
+		static ent_type entity(index_type idx) { return _compToEnt[idx]; }
+		static index_type index(ent_type e) { return _entToComp[e.id]; }
+		static void move(ent_type from, ent_type to) {
+			const index_type idx = _entToComp[from.id];
+			_entToComp.slot(to.id) = idx;
+			_compToEnt[idx] = to;
+		}
+		// the field arrays, indexed like entity()
+		static Columns& columns() { return _cols; }
+
+		static void reserve(size_type n, size_type extra) {
+			const size_type size = _compToEnt.size() + extra;
+			_entToComp.reserve(n);
+			_cols.each([=](auto& c) { c.ensure(size); });
+			_compToEnt.ensure(size);
+		}
+		static AllocStats stats() {
+			AllocStats st = _compToEnt.stats();
+			st += _entToComp.stats();
+			_cols.each([&](auto& c) { st += c.stats(); });
+			return st;
+		}
+		static void clear() {
+			_cols.each([](auto& c) { c.clear(); });
+			_compToEnt.clear();
+		}
+		static void release() {
+			_cols.each([](auto& c) { c.release(); });
+			_compToEnt.release();
+			_entToComp.release();
+		}
+
+		static void save(Snapshot& s, size_type n) {
+			const size_type size = _compToEnt.size();
+			s.write(&size, sizeof(size));
+			_cols.each([&](auto& c) { c.save(s); });
+			s.write(_compToEnt.data(), sizeof(ent_type)*size);
+			_entToComp.save(s, n);
+		}
+		static void load(const Snapshot& s, size_type& at, size_type n) {
+			size_type size;
+			s.read(at, &size, sizeof(size));
+			_cols.each([&](auto& c) { c.load(s, at, size); });
+			_compToEnt.resize(size);
+			s.read(at, _compToEnt.data(), sizeof(ent_type)*size);
+			_entToComp.load(s, at, n);
+		}
+	private:
+		static inline Columns									_cols;
+		static inline PagedBag<index_type>						_entToComp;
+		static inline Bag<ent_type,Params.InitialPackedSize>	_compToEnt;
 	};
 
 	template <class T>
@@ -180,73 +988,139 @@ namespace bagel
 	{
 	public:
 		using bit_type = mask_type;
-		static constexpr bit_type bit(index_type idx) { return 1<<idx; }
+		static constexpr bit_type bit(index_type idx) { return bit_type{1}<<idx; }
 
-		void set(const bit_type b) { _mask |= b; }
+		constexpr void set(const bit_type b) { _mask |= b; }
 
-		void clear(const bit_type b) { _mask &= ~b; }
-		void clear() { _mask = 0; }
+		constexpr void clear(const bit_type b) { _mask &= ~b; }
+		constexpr void clear() { _mask = 0; }
 
-		bool test(const bit_type b) const { return _mask & b; }
-		bool test(const SingleMask m) const { return (_mask & m._mask) == m._mask; }
+		constexpr bool test(const bit_type b) const { return _mask & b; }
+		constexpr bool test(const SingleMask m) const { return (_mask & m._mask) == m._mask; }
 
-		index_type ctz() const { return _mask ? __builtin_ctz(_mask) : -1; }
+		index_type ctz() const { return _mask ? __builtin_ctzll(_mask) : -1; }
 	private:
 		mask_type	_mask{0};
 	};
+	// Words 64-bit words; test() compares 4 words per AVX2 op or 2 per SSE2 op when those are enabled
+	template <size_type Words>
 	class MultiMask final
 	{
 	public:
+		using word_type = std::uint64_t;
+		static constexpr size_type WordBits = 64;
 		using bit_type = struct {
 			const index_type	index;
-			const mask_type		mask;
+			const word_type		mask;
 		};
 		static constexpr bit_type bit(index_type idx) {
-			return {idx/BitsetWidth, static_cast<mask_type>(1<<(idx%BitsetWidth))};
+			return {idx/WordBits, word_type{1}<<(idx%WordBits)};
 		}
 
-		void set(const bit_type& b) { _masks[b.index] |= b.mask; }
-
-		void clear(const bit_type& b) { _masks[b.index] &= ~b.mask; }
-		void clear() { memset(_masks, 0, sizeof(_masks)); }
+		constexpr void set(const bit_type& b) { _masks[b.index] |= b.mask; }
 
-		bool test(const bit_type& b) const { return _masks[b.index] & b.mask; }
-		bool test(const MultiMask& m) const {
+		constexpr void clear(const bit_type& b) { _masks[b.index] &= ~b.mask; }
+		constexpr void clear() {
 			for (index_type i = 0; i < Size; ++i)
+				_masks[i] = 0;
+		}
+
+		constexpr bool test(const bit_type& b) const { return _masks[b.index] & b.mask; }
+		constexpr bool test(const MultiMask& m) const {
+			index_type i = 0;
+			if (!__builtin_is_constant_evaluated()) {
+#if defined(__AVX2__)
+				for (; i + 4 <= Size; i += 4) {
+					const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_masks + i));
+					const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m._masks + i));
+					if (!_mm256_testc_si256(a, b))
+						return false;
+				}
+#endif
+#if defined(__SSE2__)
+				for (; i + 2 <= Size; i += 2) {
+					const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_masks + i));
+					const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m._masks + i));
+					if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(a, b), b)) != 0xFFFF)
+						return false;
+				}
+#endif
+			}
+			for (; i < Size; ++i)
 				if ((_masks[i] & m._masks[i]) != m._masks[i])
 					return false;
 			return true;
 		}
 
 		index_type ctz() const {
-			for (index_type i = 0; i < Size; ++i) {
-				if (_masks[i]) {
-					int c = __builtin_ctz(_masks[i]);
-					return c + i*BitsetWidth;
-				}
-			}
+			for (index_type i = 0; i < Size; ++i)
+				if (_masks[i])
+					return __builtin_ctzll(_masks[i]) + i*WordBits;
 			return -1;
 		}
 	private:
-		static constexpr size_type	Size = (Params.MaxComponents-1)/BitsetWidth + 1;
-		mask_type					_masks[Size] ={};
+		static constexpr size_type	Size = Words;
+		word_type					_masks[Size] = {};
 	};
-	using Mask = std::conditional_t<Params.MaxComponents<=BitsetWidth, SingleMask, MultiMask>;
+	using Mask = std::conditional_t<Params.MaxComponents<=BitsetWidth,
+		SingleMask, MultiMask<(Params.MaxComponents-1)/MultiMask<1>::WordBits + 1>>;
 
-	static inline index_type compCounter = -1;
-	template <class>
+	// position of T in a ComponentList, or -1
+	template <class T, class L> constexpr index_type IndexIn = -1;
+	template <class T, class U, class ...Us>
+	constexpr index_type IndexIn<T, ComponentList<U, Us...>> =
+		std::is_same_v<T, U> ? 0 :
+		IndexIn<T, ComponentList<Us...>> < 0 ? -1 : IndexIn<T, ComponentList<Us...>> + 1;
+
+	template <class ...Ts>
+	constexpr size_type CountOf(ComponentList<Ts...>) { return sizeof...(Ts); }
+	static_assert(CountOf(Components{}) <= Params.MaxComponents, "more registered components than MaxComponents");
+
+	// registered components (BAGEL_COMPONENTS) have fixed, compile-time indices in list order;
+	// any other type is numbered after them on first use, so its index depends on init order
+	inline index_type compCounter = CountOf(Components{}) - 1;
+	template <class T, bool = (IndexIn<T, Components> >= 0)>
 	struct Component final : NoInstance
 	{
-		static inline const index_type		Index = ++compCounter;
+		static constexpr index_type			Index = IndexIn<T, Components>;
+		static constexpr Mask::bit_type		Bit = Mask::bit(Index);
+		static constexpr index_type index() { return Index; }
+	};
+	template <class T>
+	struct Component<T, false> final : NoInstance
+	{
+		// Index, assigned on first call, for static initializers that may run before Index is set
+		static index_type index() {
+			static const index_type i = ++compCounter;
+			return i;
+		}
+		static inline const index_type		Index = index();
 		static inline const Mask::bit_type	Bit = Mask::bit(Index);
 	};
 
+	template <class T>
+	struct Resource final : NoInstance {
+		static inline T value{};
+	};
+
 	struct AddedMask {
 		Mask prev;
 		Mask next;
 		ent_type e;
 	};
 
+	// old id to new id, filled by World::compact(); ids that were free map to {-1}
+	class Remap : NoCopy
+	{
+	public:
+		ent_type operator()(ent_type e) const { return e.id < _to.size() ? _to[e.id] : ent_type{-1}; }
+	private:
+		friend class World;
+		DynamicBag<ent_type, 64> _to;
+	};
+
+	class IdCache;
+
 	class World final : NoInstance
 	{
 	public:
@@ -262,7 +1136,7 @@ namespace bagel
 				int ctz = m.ctz(); // count-trailing-zeros
 				while (ctz >= 0) {
 					if (_callbacks[ctz].destroy != nullptr)
-						_callbacks->destroy(ent);
+						_callbacks[ctz].destroy(ent);
 					m.clear(Mask::bit(ctz));
 					ctz = m.ctz();
 				}
@@ -275,32 +1149,215 @@ namespace bagel
 		}
 		static ent_type maxId() { return _maxId; }
 
+		// opens a phase in which IdCache::create() may run on any thread; until endConcurrent() the
+		// main thread must not create, destroy or compact. createEntity() itself stays unsynchronized
+		static void beginConcurrent() {
+			_shared.store(_maxId.id + 1, std::memory_order_relaxed);
+			_freeTop.store(_ids.size(), std::memory_order_relaxed);
+		}
+		// after the workers joined: drops the free ids they took and gives the new ids empty masks
+		static void endConcurrent() {
+			_ids.resize(std::max(_freeTop.load(std::memory_order_relaxed), 0));
+			const id_type n = _shared.load(std::memory_order_relaxed);
+			for (id_type id = _maxId.id + 1; id < n; ++id)
+				_masks.push(Mask{});
+			_maxId = {n - 1};
+		}
+
+		// f(e) for each entity that has all of Ts. The smallest packed or split pool among Ts drives
+		// the loop and the mask checks the rest; with none of those every id is visited. Pool order
+		// is not id order, and f must not add or remove Ts: queue that in a CommandBuffer
+		template <class ...Ts, class F>
+		static void each(F&& f) {
+			Mask m;
+			(m.set(Component<Ts>::Bit), ...);
+
+			size_type n = 0;
+			ent_type (*at)(index_type) = nullptr;
+			(drive<Ts>(n, at), ...);
+			if (at == nullptr)
+				n = _maxId.id + 1;
+			for (index_type i = 0; i < n; ++i) {
+				const ent_type e = at ? at(i) : ent_type{i};
+				if (_masks[e.id].test(m))
+					f(e);
+			}
+		}
+
+		static void reserve(size_type n) { _masks.ensure(n); }
+		// entity-indexed arrays cover ids [0,n); packed arrays get room for extra components beyond
+		// the ones each type holds now, so a type with two instances does not reserve n
+		template <class T, class ...Ts>
+		static void reserveComponents(size_type n, size_type extra) {
+			Storage<T>::type::reserve(n, extra);
+			if constexpr (sizeof...(Ts)>0)
+				reserveComponents<Ts...>(n, extra);
+		}
+
+		// drops every entity at once, emptying the storages of Ts; observers do not run
+		template <class ...Ts>
+		static void clear() {
+			_maxId = {-1};
+			_masks.clear();
+			_ids.clear();
+			(Storage<Ts>::type::clear(), ...);
+		}
+		// clear(), then gives back the memory of the masks, free ids, and the storages and change
+		// ticks of Ts. Under the arena policy it all goes in one ArenaAlloc::reset(), so Ts must
+		// name every component that allocated
+		template <class ...Ts>
+		static void release() {
+			clear<Ts...>();
+			_masks.release();
+			_ids.release();
+			(Storage<Ts>::type::release(), ...);
+			(releaseTicks<Ts>(), ...);
+			if constexpr (Params.Allocator == AllocPolicy::Arena)
+				ArenaAlloc::reset();
+		}
+
+		// renumbers the live entities densely in their current order, moving masks, change ticks and
+		// the storages of Ts, and shrinks maxId; free ids are dropped. Observers do not run, groups
+		// keep their order, and ids held elsewhere (queued commands, user data) go through remap
+		template <class ...Ts>
+		static void compact(Remap& remap) {
+			const size_type n = _maxId.id + 1;
+			remap._to.resize(n);
+			for (index_type i = 0; i < n; ++i)
+				remap._to[i] = {i};
+			for (index_type i = 0; i < _ids.size(); ++i)
+				remap._to[_ids[i].id] = {-1};
+
+			id_type next = 0;
+			for (index_type i = 0; i < n; ++i) {
+				if (remap._to[i].id < 0)
+					continue;
+				const ent_type from{i}, to{next++};
+				remap._to[i] = to;
+				if (to.id == from.id)
+					continue;
+				(moveComponent<Ts>(from, to), ...);
+				_masks[to.id] = _masks[from.id];
+			}
+			_masks.resize(next);
+			_ids.clear();
+			_maxId = {next - 1};
+		}
+
+		// copies masks, free ids and the storages of Ts; components left out of Ts are not restored
+		template <class ...Ts>
+		static void snapshot(Snapshot& s) {
+			const size_type n = _maxId.id + 1;
+			const size_type ids = _ids.size();
+			s.clear();
+			s.write(&_maxId, sizeof(_maxId));
+			s.write(_masks.data(), sizeof(Mask)*n);
+			s.write(&ids, sizeof(ids));
+			s.write(_ids.data(), sizeof(ent_type)*ids);
+			(Storage<Ts>::type::save(s, n), ...);
+		}
+		// Ts must match snapshot(); a bulk copy, so observers do not run;
+		// returns the offset of whatever the caller appended after it
+		template <class ...Ts>
+		static size_type restore(const Snapshot& s) {
+			size_type at = 0;
+			size_type ids;
+			s.read(at, &_maxId, sizeof(_maxId));
+			const size_type n = _maxId.id + 1;
+			_masks.resize(n);
+			s.read(at, _masks.data(), sizeof(Mask)*n);
+			s.read(at, &ids, sizeof(ids));
+			_ids.resize(ids);
+			s.read(at, _ids.data(), sizeof(ent_type)*ids);
+			(Storage<Ts>::type::load(s, at, n), ...);
+			_restoredAt = _tick;
+			return at;
+		}
+
 		template <class T>
-		static T& getComponent(ent_type e) {
-			return Storage<T>::type::get(e);
+		static T& resource() {
+			return Resource<T>::value;
 		}
 
+		// counts frames for change detection; the caller's loop advances it once per tick
+		static std::uint32_t tick() { return _tick; }
+		static void advanceTick() { ++_tick; }
+
+		// mutable access stamps T as changed on tracked types, readComponent() does not;
+		// bit-packed and split types hand out a proxy
 		template <class T>
-		static void addComponent(ent_type e, const T& t) {
+		static decltype(auto) getComponent(ent_type e) {
+			markChanged<T>(e);
+			return Storage<T>::type::get(e);
+		}
+		// a copy for storages that hand out proxies
+		template <class T>
+		static decltype(auto) readComponent(ent_type e) {
+			if constexpr (std::is_reference_v<decltype(Storage<T>::type::get(e))>)
+				return static_cast<const T&>(Storage<T>::type::get(e));
+			else
+				return static_cast<T>(Storage<T>::type::get(e));
+		}
+		template <class T>
+		static void markChanged(ent_type e) {
+			if constexpr (TrackChanges<T>::value)
+				ChangeTicks<T>::ticks.slot(e.id) = _tick;
+		}
+		// a restore counts as a change of everything
+		template <class T>
+		static bool changedSince(ent_type e, std::uint32_t since) {
+			static_assert(TrackChanges<T>::value, "T has no change ticks");
+			return ChangeTicks<T>::ticks[e.id] >= since || _restoredAt >= since;
+		}
+		// true if e has every component named in Fs, and every Changed<T> of them changed since the tick
+		template <class ...Fs>
+		static bool matches(ent_type e, std::uint32_t since) {
+			Mask m;
+			(m.set(Component<typename FilterTraits<Fs>::type>::Bit), ...);
+			if (!_masks[e.id].test(m))
+				return false;
+			return (passes<Fs>(e, since) && ...);
+		}
+
+		// builds the component in its storage from args, see make()
+		template <class T, class ...Args>
+		static void emplaceComponent(ent_type e, Args&&... args) {
 			Mask prev = _masks[e.id];
 
 			_masks[e.id].set(Component<T>::Bit);
-			Storage<T>::type::add(e,t);
+			Storage<T>::type::emplace(e, std::forward<Args>(args)...);
+			if constexpr (TrackChanges<T>::value) {
+				ChangeTicks<T>::ticks.slot(e.id) = _tick;
+			}
 
 			if constexpr (Params.AggregateUpdates) {
 				Mask next = _masks[e.id];
 				//_added.push({prev,next,e});
 			}
+			if constexpr (DestroyHook<T>)
+				(void)Hook<T>::installed;
+			if constexpr (Owned<T>)
+				Owner<T>::type::enter(e);
+			if constexpr (ObservesAdd<T>)
+				Observer<T>::onAdd(e);
+		}
+		template <class T>
+		static void addComponent(ent_type e, T&& t) {
+			emplaceComponent<std::decay_t<T>>(e, std::forward<T>(t));
 		}
 		template <class T, class...Ts>
-		static void addComponents(ent_type e, const T& t, const Ts&... ts) {
-			addComponent(e, t);
+		static void addComponents(ent_type e, T&& t, Ts&&... ts) {
+			addComponent(e, std::forward<T>(t));
 			if constexpr (sizeof...(Ts)>0)
-				addComponents(e, ts...);
+				addComponents(e, std::forward<Ts>(ts)...);
 		}
 
 		template <class T>
 		static void delComponent(ent_type e) {
+			if constexpr (ObservesRemove<T>)
+				Observer<T>::onRemove(e);
+			if constexpr (Owned<T>)
+				Owner<T>::type::leave(e);
 			_masks[e.id].clear(Component<T>::Bit);
 			Storage<T>::type::del(e);
 		}
@@ -311,9 +1368,12 @@ namespace bagel
 				delComponents<Ts...>(e);
 		}
 
+		// assigns through the world so that update observers run
 		template <class T>
-		static void registerStorage(StorageCallbacks& cb) {
-			_callbacks[Component<T>::Index] = cb;
+		static void setComponent(ent_type e, const T& t) {
+			getComponent<T>(e) = t;
+			if constexpr (ObservesUpdate<T>)
+				Observer<T>::onUpdate(e);
 		}
 
 		// static size_type sizeAdded() { return _added.size(); }
@@ -321,21 +1381,125 @@ namespace bagel
 		//
 		// static void step() { _added.clear(); }
 	private:
+		// release() of the change ticks of a tracked T
+		template <class T>
+		static void releaseTicks() {
+			if constexpr (TrackChanges<T>::value)
+				ChangeTicks<T>::ticks.release();
+		}
+		// compact() of one component: T moves from one id to the other, if the entity has it
+		template <class T>
+		static void moveComponent(ent_type from, ent_type to) {
+			if (!_masks[from.id].test(Component<T>::Bit))
+				return;
+			Storage<T>::type::move(from, to);
+			if constexpr (TrackChanges<T>::value)
+				ChangeTicks<T>::ticks.slot(to.id) = ChangeTicks<T>::ticks[from.id];
+		}
+		template <class T>
+		static constexpr bool Pooled = std::is_same_v<typename Storage<T>::type, PackedStorage<T>> ||
+			std::is_same_v<typename Storage<T>::type, SplitStorage<T>>;
+		template <class T>
+		static void drive(size_type& n, ent_type (*&at)(index_type)) {
+			if constexpr (Pooled<T>) {
+				if (at == nullptr || Storage<T>::type::size() < n) {
+					n = Storage<T>::type::size();
+					at = Storage<T>::type::entity;
+				}
+			}
+		}
+		template <class T>
+		static constexpr bool BitPacked = std::is_same_v<typename Storage<T>::type, BitPackedStorage<T>>;
+		template <class T>
+		static constexpr bool DestroyHook = ObservesRemove<T> || Owned<T> ||
+			Pooled<T> || BitPacked<T> ||
+			!std::is_trivially_destructible_v<T>;
+		// destroyEntity() hook of packed, split, observed, grouped and non-trivial types; see Hook
+		template <class T>
+		static void removed(ent_type e) {
+			if constexpr (ObservesRemove<T>)
+				Observer<T>::onRemove(e);
+			if constexpr (Owned<T>)
+				Owner<T>::type::leave(e);
+			Storage<T>::type::del(e);
+		}
+		template <class F>
+		static bool passes(ent_type e, std::uint32_t since) {
+			if constexpr (FilterTraits<F>::changed)
+				return changedSince<typename FilterTraits<F>::type>(e, since);
+			else
+				return true;
+		}
+
 		static inline StorageCallbacks _callbacks[Params.MaxComponents] = {nullptr};
+		// installs removed<T> at static init for every T that emplaceComponent<T> is instantiated
+		// with, so adds do not store it again
+		template <class T>
+		struct Hook final : NoInstance {
+			static inline const bool installed = (_callbacks[Component<T>::index()].destroy = removed<T>, true);
+		};
 		//static inline Bag<AddedMask,1000>		_added;
 
+		static inline std::uint32_t							_tick = 1;
+		static inline std::uint32_t							_restoredAt = 0;
 		static inline ent_type								_maxId{-1};
 		static inline Bag<Mask,		Params.InitialEntities> _masks;
 		static inline Bag<ent_type,	Params.IdBagSize>		_ids;
+
+		friend IdCache;
+		// next fresh id and the untaken part of _ids while concurrent
+		static inline std::atomic<id_type>					_shared{0};
+		static inline std::atomic<index_type>				_freeTop{0};
 	};
 
-	template <class T>
-	class StorageRegister
+	// entity ids for one thread between World::beginConcurrent() and endConcurrent(). Free ids, then
+	// fresh blocks, are taken IdBlockSize at a time with one relaxed atomic op; only the ids are
+	// concurrent, so queue components for the main thread, e.g. in a per-thread CommandBuffer.
+	// Destroy the cache on the main thread after endConcurrent(): its unused ids go back to World
+	class IdCache : NoCopy
 	{
 	public:
-		StorageRegister(StorageCallbacks& cb) {
-			World::registerStorage<T>(cb);
+		ent_type create() {
+			if (_free.size() == 0 && _next == _end)
+				refill();
+			if (_free.size() > 0)
+				return _free.pop();
+			return {_next++};
+		}
+		// takes back an id from create() that never got components
+		void destroy(ent_type e) { _free.push(e); }
+
+		~IdCache() {
+			while (_free.size() > 0)
+				giveBack(_free.pop());
+			while (_end > _next)
+				giveBack({--_end});
+		}
+	private:
+		static constexpr size_type Block = Params.IdBlockSize;
+
+		// a full fixed-size World::_ids drops the id: it stays an empty hole until World::compact()
+		static void giveBack(ent_type e) {
+			if constexpr (!Params.DynamicResize)
+				if (World::_ids.size() == World::_ids.capacity())
+					return;
+			World::_ids.push(e);
 		}
+
+		void refill() {
+			const index_type top = World::_freeTop.fetch_sub(Block, std::memory_order_relaxed);
+			for (index_type i = std::max(top - Block, 0); i < top; ++i)
+				_free.push(World::_ids[i]);
+			if (_free.size() == 0) {
+				_next = World::_shared.fetch_add(Block, std::memory_order_relaxed);
+				_end = _next + Block;
+			}
+		}
+
+		// malloc-backed, as the arena and pool allocators are not thread-safe
+		DynamicBag<ent_type, Params.IdBlockSize, MallocAlloc>	_free;
+		id_type													_next = 0;
+		id_type													_end = 0;
 	};
 
 	class Entity
@@ -349,16 +1513,20 @@ namespace bagel
 
 		const Mask& mask() const { return World::mask(_ent); }
 
-		template <class T> T& get() const { return World::getComponent<T>(_ent); }
-		template <class T> void add(const T& t) const {
-			return World::addComponent<T>(_ent, t);
+		template <class T> decltype(auto) get() const { return World::getComponent<T>(_ent); }
+		template <class T> decltype(auto) read() const { return World::readComponent<T>(_ent); }
+		template <class T> void add(T&& t) const {
+			return World::addComponent(_ent, std::forward<T>(t));
+		}
+		template <class T, class ...Args> void emplace(Args&&... args) const {
+			return World::emplaceComponent<T>(_ent, std::forward<Args>(args)...);
 		}
 		template <class T> void del() const {
 			return World::delComponent<T>(_ent);
 		}
 
-		template <class T, class ...Ts> void addAll(const T& t, const Ts&... ts) const {
-			World::addComponents(_ent, t, ts...);
+		template <class T, class ...Ts> void addAll(T&& t, Ts&&... ts) const {
+			World::addComponents(_ent, std::forward<T>(t), std::forward<Ts>(ts)...);
 		}
 		template <class T, class ...Ts> void delAll() const {
 			World::delComponents<T,Ts...>(_ent);
@@ -370,16 +1538,185 @@ namespace bagel
 		ent_type _ent;
 	};
 
+	// structural changes recorded while iterating and applied in order by flush();
+	// entity ids are taken at create() time, so commands can already target them
+	class CommandBuffer : NoCopy
+	{
+	public:
+		Entity create() { return World::createEntity(); }
+		// for a worker thread's buffer, flushed after World::endConcurrent()
+		Entity create(IdCache& ids) { return ids.create(); }
+		// an entity queued twice (or already destroyed, so its mask is empty) is skipped,
+		// so its id is recycled once
+		void destroy(ent_type e) {
+			push(e, 0, [](ent_type e, void*) {
+				if (World::mask(e).ctz() >= 0)
+					World::destroyEntity(e);
+			});
+		}
+		template <class T>
+		void add(ent_type e, const T& t) {
+			static_assert(std::is_trivially_destructible_v<T>, "queued components are never destroyed");
+			new (push(e, sizeof(T), [](ent_type e, void* p) {
+				World::addComponent(e, std::move(*static_cast<T*>(p)));
+			})) T(t);
+		}
+		template <class T>
+		void del(ent_type e) {
+			push(e, 0, [](ent_type e, void*) { World::delComponent<T>(e); });
+		}
+		// runs f() at flush time, in order with the other commands
+		template <class F>
+		void defer(const F& f) {
+			static_assert(std::is_trivially_destructible_v<F>, "queued callables are never destroyed");
+			new (push({-1}, sizeof(F), [](ent_type, void* p) { (*static_cast<F*>(p))(); })) F(f);
+		}
+
+		// commands queued by the applied ones run in the same flush, after the batch that queued them;
+		// they go to a fresh buffer, so a growth never moves the command being applied
+		void flush() {
+			while (_size > 0) {
+				char* data = _data;
+				const size_type size = _size, capacity = _capacity;
+				_data = nullptr;
+				_size = _capacity = 0;
+				for (size_type at = 0; at < size; ) {
+					auto* h = reinterpret_cast<Header*>(data + at);
+					at += h->bytes;
+					h->apply(h->e, h + 1);
+				}
+				if (_data == nullptr) {
+					_data = data;
+					_capacity = capacity;
+				}
+				else
+					free(data);
+			}
+		}
+		bool empty() const { return _size == 0; }
+
+		~CommandBuffer() { free(_data); }
+	private:
+		using Apply = void (*)(ent_type, void*);
+		struct alignas(16) Header {
+			Apply		apply;
+			ent_type	e;
+			size_type	bytes;
+		};
+
+		void* push(ent_type e, size_type payload, Apply apply) {
+			const size_type bytes = sizeof(Header) + (payload + alignof(Header) - 1) / alignof(Header) * alignof(Header);
+			if (_size + bytes > _capacity) {
+				_capacity = std::max(_size + bytes, _capacity*2);
+				_data = static_cast<char*>(realloc(_data, _capacity));
+			}
+			auto* h = new (_data + _size) Header{apply, e, bytes};
+			_size += bytes;
+			return h + 1;
+		}
+
+		char*		_data = nullptr;
+		size_type	_size = 0;
+		size_type	_capacity = 0;
+	};
+
+	// keeps the entities that have all of Ts at the front of every Ts storage, in the same order,
+	// so iterating the group zips dense arrays; World keeps it up to date on add/del/destroy
+	template <class T, class ...Ts>
+	class Group<T, Ts...> final : NoInstance
+	{
+	public:
+		static size_type size() { return PackedStorage<T>::_grouped; }
+		static ent_type entity(index_type i) { return PackedStorage<T>::entity(i); }
+
+		// f(ent_type, T&, Ts&...) for each member; members must not be added or removed meanwhile
+		template <class F>
+		static void each(F&& f) {
+			const size_type n = size();
+			for (index_type i = 0; i < n; ++i)
+				f(entity(i), PackedStorage<T>::get(i), PackedStorage<Ts>::get(i)...);
+		}
+
+		static bool contains(ent_type e) {
+			const index_type i = PackedStorage<T>::index(e);
+			return i < size() && entity(i).id == e.id;
+		}
+		static void enter(ent_type e) {
+			Mask m;
+			m.set(Component<T>::Bit);
+			(m.set(Component<Ts>::Bit), ...);
+			if (!World::mask(e).test(m) || contains(e))
+				return;
+			const index_type at = size();
+			move<T>(e, at);
+			(move<Ts>(e, at), ...);
+			++PackedStorage<T>::_grouped;
+			((++PackedStorage<Ts>::_grouped), ...);
+		}
+		static void leave(ent_type e) {
+			if (!contains(e))
+				return;
+			const index_type at = size() - 1;
+			move<T>(e, at);
+			(move<Ts>(e, at), ...);
+			--PackedStorage<T>::_grouped;
+			((--PackedStorage<Ts>::_grouped), ...);
+		}
+	private:
+		template <class C>
+		static void move(ent_type e, index_type at) {
+			static_assert(std::is_same_v<typename Storage<C>::type, PackedStorage<C>>, "grouped components need PackedStorage");
+			static_assert(std::is_same_v<typename Owner<C>::type, Group>, "Owner<C> must name this group");
+			PackedStorage<C>::swap(PackedStorage<C>::index(e), at);
+		}
+	};
+
 	class MaskBuilder
 	{
 	public:
 		template <class T>
-		MaskBuilder& set() {
+		constexpr MaskBuilder& set() {
 			m.set(Component<T>::Bit);
 			return *this;
 		}
-		Mask build() const { return m; }
+		constexpr Mask build() const { return m; }
 	private:
 		Mask m;
 	};
 }
+
+#define BAGEL_FOR_EACH_1(M, T, f) M(T, f)
+#define BAGEL_FOR_EACH_2(M, T, f, ...) M(T, f) BAGEL_FOR_EACH_1(M, T, __VA_ARGS__)
+#define BAGEL_FOR_EACH_3(M, T, f, ...) M(T, f) BAGEL_FOR_EACH_2(M, T, __VA_ARGS__)
+#define BAGEL_FOR_EACH_4(M, T, f, ...) M(T, f) BAGEL_FOR_EACH_3(M, T, __VA_ARGS__)
+#define BAGEL_FOR_EACH_5(M, T, f, ...) M(T, f) BAGEL_FOR_EACH_4(M, T, __VA_ARGS__)
+#define BAGEL_FOR_EACH_6(M, T, f, ...) M(T, f) BAGEL_FOR_EACH_5(M, T, __VA_ARGS__)
+#define BAGEL_FOR_EACH_7(M, T, f, ...) M(T, f) BAGEL_FOR_EACH_6(M, T, __VA_ARGS__)
+#define BAGEL_FOR_EACH_8(M, T, f, ...) M(T, f) BAGEL_FOR_EACH_7(M, T, __VA_ARGS__)
+#define BAGEL_FOR_EACH_N(_1, _2, _3, _4, _5, _6, _7, _8, N, ...) BAGEL_FOR_EACH_##N
+#define BAGEL_FOR_EACH(M, T, ...) BAGEL_FOR_EACH_N(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1)(M, T, __VA_ARGS__)
+
+#define BAGEL_SPLIT_COLUMN(T, f)	::bagel::Column<decltype(T::f)> f;
+#define BAGEL_SPLIT_EACH(T, f)		fn(f);
+#define BAGEL_SPLIT_PUSH(T, f)		f.push(t.f);
+#define BAGEL_SPLIT_INIT(T, f)		f[i],
+#define BAGEL_SPLIT_MEMBER(T, f)	decltype(T::f)& f;
+#define BAGEL_SPLIT_TO(T, f)		::bagel::assignField(t.f, f);
+#define BAGEL_SPLIT_FROM(T, f)		::bagel::assignField(f, t.f);
+
+// the columns of T for SplitStorage, one per listed field; list every field of T, at most 8, at global
+// scope after T is complete. Select the storage itself with BAGEL_STORAGE(T, SplitStorage) in bagel_cfg.h
+#define BAGEL_SPLIT(T, ...) \
+	template <> struct bagel::SplitFields<T> { \
+		struct Ref { \
+			BAGEL_FOR_EACH(BAGEL_SPLIT_MEMBER, T, __VA_ARGS__) \
+			operator T() const { T t; BAGEL_FOR_EACH(BAGEL_SPLIT_TO, T, __VA_ARGS__) return t; } \
+			const Ref& operator=(const T& t) const { BAGEL_FOR_EACH(BAGEL_SPLIT_FROM, T, __VA_ARGS__) return *this; } \
+		}; \
+		struct Columns { \
+			BAGEL_FOR_EACH(BAGEL_SPLIT_COLUMN, T, __VA_ARGS__) \
+			template <class F> void each(F&& fn) { BAGEL_FOR_EACH(BAGEL_SPLIT_EACH, T, __VA_ARGS__) } \
+			void push(const T& t) { BAGEL_FOR_EACH(BAGEL_SPLIT_PUSH, T, __VA_ARGS__) } \
+			Ref ref(::bagel::index_type i) { return Ref{BAGEL_FOR_EACH(BAGEL_SPLIT_INIT, T, __VA_ARGS__)}; } \
+		}; \
+	};
@@ -1,7 +1,36 @@
-#pragma once
+// read twice by bagel.h: once at global scope with BAGEL_DECLARE defined, then inside namespace bagel
 
+#ifdef BAGEL_DECLARE
+namespace pacman {
+	struct Position;
+	struct Drawable;
+	struct Collider;
+	struct Intent;
+	struct Input;
+	struct Pellet;
+	struct PlayerStats;
+	struct PlayerControlled;
+	struct Ghost;
+	struct Wall;
+	struct Background;
+}
+#else
 constexpr Bagel Params{
-	.DynamicResize = false
+	.DynamicResize = false,
+	.IdBagSize = 1000,
+	.InitialPackedSize = 1000,
+	.MaxComponents = 32
 };
 
+// fixed component indices, in list order; append new types so existing masks keep their bits
+BAGEL_COMPONENTS(
+	::pacman::Position, ::pacman::Drawable, ::pacman::Collider, ::pacman::Intent, ::pacman::Input,
+	::pacman::Pellet, ::pacman::PlayerStats, ::pacman::PlayerControlled, ::pacman::Ghost,
+	::pacman::Wall, ::pacman::Background)
+
 //BAGEL_STORAGE(Position,PackedStorage)
+BAGEL_STORAGE(::pacman::Intent,PackedStorage)
+BAGEL_STORAGE(::pacman::Collider,PackedStorage)
+// field list in Pacman.h (BAGEL_SPLIT), where Drawable is complete
+BAGEL_STORAGE(::pacman::Drawable,SplitStorage)
+#endif
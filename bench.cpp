@@ -0,0 +1,68 @@
+// MultiMask::test() against a plain word loop over the same bits; build with -mavx2 to measure
+// the AVX2 path instead of SSE2
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include "bagel.h"
+using namespace bagel;
+
+template <int Words>
+struct PlainMask { std::uint64_t w[Words]; };
+
+template <int Words>
+bool plainTest(const PlainMask<Words>& m, const PlainMask<Words>& sub) {
+	for (int i = 0; i < Words; ++i)
+		if ((m.w[i] & sub.w[i]) != sub.w[i])
+			return false;
+	return true;
+}
+
+template <int Words>
+void benchMask() {
+	constexpr int Masks = 4096, Rounds = 20000;
+	static MultiMask<Words> masks[Masks];
+	static PlainMask<Words> plain[Masks];
+
+	std::mt19937_64 rng(1);
+	for (int i = 0; i < Masks; ++i)
+		for (int b = 0; b < Words * 64; ++b)
+			if (rng() % 3 == 0) {
+				masks[i].set(MultiMask<Words>::bit(b));
+				plain[i].w[b / 64] |= std::uint64_t{1} << b % 64;
+			}
+	MultiMask<Words> sub;
+	PlainMask<Words> plainSub{};
+	for (int b : {1, 5, Words * 64 - 1}) {
+		sub.set(MultiMask<Words>::bit(b));
+		plainSub.w[b / 64] |= std::uint64_t{1} << b % 64;
+	}
+
+	volatile int sink = 0;
+	const auto t0 = std::chrono::steady_clock::now();
+	for (int r = 0; r < Rounds; ++r) {
+		int hits = 0;
+		for (int i = 0; i < Masks; ++i)
+			hits += masks[i].test(sub);
+		sink = sink + hits;
+	}
+	const auto t1 = std::chrono::steady_clock::now();
+	for (int r = 0; r < Rounds; ++r) {
+		int hits = 0;
+		for (int i = 0; i < Masks; ++i)
+			hits += plainTest<Words>(plain[i], plainSub);
+		sink = sink + hits;
+	}
+	const auto t2 = std::chrono::steady_clock::now();
+
+	const double tests = double(Masks) * Rounds;
+	std::printf("%3d bits: MultiMask %.2f ns/test, plain loop %.2f ns/test\n", Words * 64,
+		std::chrono::duration<double, std::nano>(t1 - t0).count() / tests,
+		std::chrono::duration<double, std::nano>(t2 - t1).count() / tests);
+}
+
+int main() {
+	benchMask<2>();
+	benchMask<4>();
+	benchMask<8>();
+	return 0;
+}
@@ -1,9 +1,41 @@
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iostream>
 #include "Pacman.h"
 using namespace pacman;
 
-int main() {
-	PacMan p;
-	if (p.valid())
+/**
+ * Usage: Pacman [--record <file> | --replay <file>]
+ *  --record saves the inputs of the session so it can be replayed later.
+ *  --replay re-simulates a saved session headless and as fast as possible.
+ */
+int main(int argc, char* argv[]) {
+	if (argc == 3 && strcmp(argv[1], "--replay") == 0) {
+		InputRecording rec;
+		if (!rec.load(argv[2])) {
+			std::cerr << "cannot read replay " << argv[2] << std::endl;
+			return 1;
+		}
+		PacMan p(rec.seed(), true);
+		const auto start = std::chrono::steady_clock::now();
+		const uint32_t ticks = p.replay(rec);
+		const std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+		std::cout << ticks << " ticks in " << ms.count() << " ms" << std::endl;
+		return 0;
+	}
+
+	const uint64_t seed = time(nullptr);
+	PacMan p(seed);
+	if (!p.valid())
+		return 0;
+	if (argc == 3 && strcmp(argv[1], "--record") == 0) {
+		InputRecording rec(seed);
+		p.run(&rec);
+		if (!rec.save(argv[2]))
+			std::cerr << "cannot write replay " << argv[2] << std::endl;
+	}
+	else
 		p.run();
 	return 0;
 }
@@ -1,5 +1,8 @@
 #include <iostream>
 #include <cassert>
+#include <string>
+#include <vector>
+#include <thread>
 #include "bagel.h"
 using namespace std;
 using namespace bagel;
@@ -18,7 +21,476 @@ void test1() {
 	cout << "Test 1 passed\n";
 }
 
+struct Health { int hp; };
+
+struct Tracked { int v; };
+static int trackedAdds = 0, trackedRemoves = 0, trackedUpdates = 0;
+template <> struct bagel::Observer<Tracked> {
+	static void onAdd(ent_type) { ++trackedAdds; }
+	static void onRemove(ent_type e) { trackedRemoves += World::getComponent<Tracked>(e).v; }
+	static void onUpdate(ent_type) { ++trackedUpdates; }
+};
+
+void test2() {
+	Snapshot s;
+	ent_type e = World::createEntity();
+	World::addComponent(e, Health{5});
+	World::snapshot<Health>(s);
+
+	World::getComponent<Health>(e).hp = 1;
+	World::delComponent<Health>(e);
+	World::createEntity();
+
+	World::restore<Health>(s);
+	assert(World::maxId().id == e.id && "Entity created after snapshot survived restore");
+	assert(World::mask(e).test(Component<Health>::Bit) && "Component mask not restored");
+	assert(World::getComponent<Health>(e).hp == 5 && "Component value not restored");
+
+	cout << "Test 2 passed\n";
+}
+
+void test3() {
+	CommandBuffer cmd;
+	ent_type a = World::createEntity();
+	ent_type b = World::createEntity();
+	World::addComponent(a, Health{1});
+	World::addComponent(b, Health{2});
+
+	int seen = 0;
+	for (ent_type e{0}; e.id <= World::maxId().id; ++e.id) {
+		if (World::mask(e).test(Component<Health>::Bit)) {
+			++seen;
+			cmd.destroy(e);
+		}
+	}
+	Entity c = cmd.create();
+	cmd.add(c.entity(), Health{7});
+	assert(seen >= 2 && World::mask(a).test(Component<Health>::Bit) && "Command applied before flush");
+	assert(!c.has<Health>() && "Component added before flush");
+
+	cmd.flush();
+	assert(!World::mask(a).test(Component<Health>::Bit) && !World::mask(b).test(Component<Health>::Bit) && "Destroy not applied");
+	assert(c.get<Health>().hp == 7 && "Add not applied");
+	assert(cmd.empty() && "Buffer not cleared by flush");
+
+	// a deferred command that grows the buffer still reads its own captures afterwards
+	int ran = 0;
+	const int marker = 1234;
+	cmd.defer([&cmd, &ran, marker] {
+		for (int i = 0; i < 1000; ++i)
+			cmd.defer([&ran] { ++ran; });
+		ran += marker;
+	});
+	cmd.flush();
+	assert(ran == 1000 + marker && cmd.empty() && "Commands queued during flush");
+
+	// an entity queued for destruction twice recycles its id once
+	ent_type d = World::createEntity();
+	World::addComponent(d, Health{3});
+	cmd.destroy(d);
+	cmd.destroy(d);
+	cmd.flush();
+	ent_type r1 = World::createEntity(), r2 = World::createEntity();
+	assert(r1.id != r2.id && "Double destroy recycled an id twice");
+	World::destroyEntity(r1);
+	World::destroyEntity(r2);
+
+	cout << "Test 3 passed\n";
+}
+
+void test4() {
+	static_assert(!ObservesAdd<Health> && !ObservesRemove<Health> && !ObservesUpdate<Health>);
+	static_assert(ObservesAdd<Tracked> && ObservesRemove<Tracked> && ObservesUpdate<Tracked>);
+
+	Entity a = Entity::create();
+	Entity b = Entity::create();
+	a.add(Tracked{1});
+	b.add(Tracked{10});
+	assert(trackedAdds == 2 && "onAdd not called");
+
+	World::setComponent(a.entity(), Tracked{2});
+	assert(trackedUpdates == 1 && a.get<Tracked>().v == 2 && "onUpdate not called");
+
+	a.del<Tracked>();
+	b.destroy();
+	assert(trackedRemoves == 12 && "onRemove not called with the component still readable");
+
+	cout << "Test 4 passed\n";
+}
+
+struct Pos { int x; };
+template <> struct bagel::TrackChanges<Pos> : std::true_type {};
+
+void test5() {
+	Entity a = Entity::create();
+	Entity b = Entity::create();
+	a.add(Pos{0});
+	b.add(Pos{0});
+
+	World::advanceTick();
+	const uint32_t since = World::tick();
+	assert(!World::matches<Changed<Pos>>(a.entity(), since) && "Stale change reported");
+
+	a.get<Pos>().x = 1;
+	(void)b.read<Pos>();
+	assert(World::matches<Changed<Pos>>(a.entity(), since) && "Mutable get not stamped");
+	assert(!World::matches<Changed<Pos>>(b.entity(), since) && "Read stamped a change");
+
+	World::advanceTick();
+	World::markChanged<Pos>(b.entity());
+	assert(World::changedSince<Pos>(b.entity(), World::tick()) && "markChanged not stamped");
+	assert(!(World::matches<Changed<Pos>, Health>(b.entity(), since)) && "Missing component matched");
+
+	World::markChanged<Pos>(ent_type{100000});
+	assert(ChangeTicks<Pos>::ticks[100000 + 4 * Params.SparsePageSize] == 0 && "Stamp wrote into the shared zero page");
+
+	cout << "Test 5 passed\n";
+}
+
+struct Vel { int v; };
+struct Acc { int a; };
+template <> struct bagel::Storage<Vel> { using type = PackedStorage<Vel>; };
+template <> struct bagel::Storage<Acc> { using type = PackedStorage<Acc>; };
+template <> struct bagel::Owner<Vel> { using type = Group<Vel, Acc>; };
+template <> struct bagel::Owner<Acc> { using type = Group<Vel, Acc>; };
+
+void test6() {
+	using G = Group<Vel, Acc>;
+	Entity a = Entity::create();
+	Entity b = Entity::create();
+	Entity c = Entity::create();
+	a.add(Vel{1});
+	b.addAll(Vel{2}, Acc{20});
+	c.add(Acc{30});
+	assert(G::size() == 1 && G::entity(0).id == b.entity().id && "Only b has both");
+
+	a.add(Acc{10});
+	c.add(Vel{3});
+	assert(G::size() == 3 && "All three grouped");
+	G::each([](ent_type, Vel& v, Acc& acc) {
+		assert(acc.a == v.v * 10 && "Group arrays misaligned");
+	});
+
+	b.del<Acc>();
+	assert(G::size() == 2 && !G::contains(b.entity()) && "b left the group");
+	c.destroy();
+	assert(G::size() == 1 && G::contains(a.entity()) && a.get<Vel>().v == 1 && "destroy left the group");
+	a.destroy();
+	b.destroy();
+	assert(G::size() == 0);
+
+	cout << "Test 6 passed\n";
+}
+
+void test7() {
+	static_assert(Component<pacman::Position>::Index == 0 && Component<pacman::Background>::Index == 10,
+		"Registered components are numbered in list order");
+	constexpr Mask m = MaskBuilder().set<pacman::Intent>().set<pacman::Collider>().build();
+	static_assert(m.test(Component<pacman::Intent>::Bit) && !m.test(Component<pacman::Position>::Bit),
+		"Masks of registered components are constants");
+	assert(Component<Vel>::Index >= CountOf(Components{}) && "Unregistered types come after the list");
+
+	cout << "Test 7 passed\n";
+}
+
+void test8() {
+	SingleMask s;
+	s.set(SingleMask::bit(BitsetWidth - 1));
+	assert(s.ctz() == BitsetWidth - 1 && "Top bit of a SingleMask");
+
+	using Wide = MultiMask<4>;
+	constexpr Wide sub = [] {
+		Wide m;
+		m.set(Wide::bit(70));
+		m.set(Wide::bit(255));
+		return m;
+	}();
+	Wide m;
+	m.set(Wide::bit(3));
+	m.set(Wide::bit(70));
+	assert(!m.test(sub) && "Missing bit 255");
+	m.set(Wide::bit(255));
+	assert(m.test(sub) && m.test(Wide::bit(255)) && m.ctz() == 3 && "Wide mask");
+	m.clear(Wide::bit(3));
+	m.clear(Wide::bit(70));
+	assert(m.ctz() == 255 && !m.test(sub));
+
+	cout << "Test 8 passed\n";
+}
+
+void test9() {
+	PagedBag<int, 64> bag;
+	bag.slot(3) = 7;
+	bag.slot(100000) = 9;
+	assert(bag.pages() == 2 && "Only written pages are allocated");
+	assert(bag[3] == 7 && bag[100000] == 9 && bag[5000] == 0 && bag[1 << 30] == 0 && "Unwritten ids read as zero");
+	static_assert(std::is_same_v<decltype(bag[0]), const int&>, "unwritten pages must not be writable through []");
+
+	Snapshot s;
+	bag.save(s, 100001);
+	PagedBag<int, 64> copy;
+	size_type at = 0;
+	copy.load(s, at, 100001);
+	assert(at == s.size() && copy.pages() == 2 && copy[100000] == 9 && "Paged snapshot");
+
+	cout << "Test 9 passed\n";
+}
+
+template <class A>
+void fillBag() {
+	DynamicBag<int, 4, A> bag;
+	for (int i = 0; i < 100000; ++i)
+		bag.push(i);
+	assert(bag[99999] == 99999 && bag[4] == 4 && bag.stats().bytes >= sizeof(int) * 100000 && "Bag contents");
+}
+
+void test10() {
+	fillBag<MallocAlloc>();
+	fillBag<ArenaAlloc>();
+	assert(ArenaAlloc::held() >= sizeof(int) * 100000 && "Arena keeps its chunks");
+	ArenaAlloc::reset();
+	assert(ArenaAlloc::held() == 0 && "Arena reset frees its chunks");
+	fillBag<PoolAlloc>();
+	fillBag<HugePageAlloc>();
+
+	void* a = PoolAlloc::allocate(1000);
+	PoolAlloc::deallocate(a, 1000);
+	void* b = PoolAlloc::allocate(900);
+	assert(b == a && "Pool reuses freed blocks");
+	PoolAlloc::deallocate(b, 900);
+
+	const std::size_t before = SparseStorage<Health>::stats().bytes;
+	Entity e = Entity::create();
+	e.add(Health{1});
+	assert(SparseStorage<Health>::stats().bytes >= before && "Storage stats");
+	e.destroy();
+
+	World::release<Health>();
+	assert(SparseStorage<Health>::stats().bytes == 0 && World::maxId().id == -1 && "Released world keeps no memory");
+	e = Entity::create();
+	e.add(Health{2});
+	assert(e.get<Health>().hp == 2 && "World usable after release");
+	e.destroy();
+
+	cout << "Test 10 passed\n";
+}
+
+// counts copies, so moves through bags and storages can be checked
+struct Name {
+	std::string s;
+	static inline int copies = 0;
+	Name(std::string s = {}) : s(std::move(s)) {}
+	Name(const Name& o) : s(o.s) { ++copies; }
+	Name(Name&&) = default;
+	Name& operator=(const Name& o) { s = o.s; ++copies; return *this; }
+	Name& operator=(Name&&) = default;
+};
+struct Tags { std::vector<int> ids; };
+template <> struct bagel::Storage<Tags> { using type = PackedStorage<Tags>; };
+
+void test11() {
+	DynamicBag<Name, 2> bag;
+	for (int i = 0; i < 100; ++i)
+		bag.emplace(std::to_string(i));
+	bag.push(Name("last"));
+	assert(Name::copies == 0 && "Bag copied on emplace, push or grow");
+	assert(bag[42].s == "42" && bag.pop().s == "last" && bag.size() == 100);
+
+	Entity a = Entity::create();
+	Entity b = Entity::create();
+	a.emplace<Name>("a");
+	b.add(Name("b"));
+	a.emplace<Tags>(std::vector<int>{1, 2, 3});
+	b.add(Tags{{4}});
+	assert(Name::copies == 0 && a.get<Name>().s == "a" && b.get<Name>().s == "b" && "Components not moved in");
+
+	a.del<Tags>();
+	assert(b.get<Tags>().ids.size() == 1 && PackedStorage<Tags>::size() == 1 && "Packed delete moves the last one in");
+	a.destroy();
+	b.destroy();
+
+	cout << "Test 11 passed\n";
+}
+
+struct Flags { bool a = false, b = false, c = false; };
+template <> struct bagel::Storage<Flags> { using type = BitPackedStorage<Flags>; };
+
+void test12() {
+	using S = BitPackedStorage<Flags>;
+	std::vector<Entity> es;
+	for (int i = 0; i < 100; ++i) {
+		es.push_back(Entity::create());
+		if (i % 2 == 0)
+			es[i].add(Flags{true, false, true});
+	}
+	assert(S::count(&Flags::a) == 50 && S::count(&Flags::b) == 0 && "Bit planes");
+
+	S::fill(&Flags::b, true);
+	assert(S::count(&Flags::b) == 50 && "Fill only sets entities that have the component");
+
+	es[4].get<Flags>()[&Flags::c] = false;
+	es[6].get<Flags>() = Flags{false, false, false};
+	const Flags f = es[4].read<Flags>();
+	assert(f.a && f.b && !f.c && !es[6].read<Flags>().a && "Proxy access");
+
+	es[8].del<Flags>();
+	es[10].destroy();
+	assert(S::count(&Flags::a) == 47 && "Removed flags are cleared");
+
+	for (int i = 0; i < 100; ++i)
+		if (i != 10)
+			es[i].destroy();
+
+	cout << "Test 12 passed\n";
+}
+
+struct Sprite { int rect[2]; float scale; int frame; };
+BAGEL_SPLIT(Sprite, rect, scale, frame)
+template <> struct bagel::Storage<Sprite> { using type = SplitStorage<Sprite>; };
+
+void test13() {
+	using S = SplitStorage<Sprite>;
+	Entity a = Entity::create();
+	Entity b = Entity::create();
+	Entity c = Entity::create();
+	a.add(Sprite{{1, 2}, 1.f, 0});
+	b.add(Sprite{{3, 4}, 2.f, 0});
+	c.add(Sprite{{5, 6}, 3.f, 0});
+
+	for (index_type i = 0; i < S::size(); ++i)
+		S::columns().frame[i] += i + 1;
+	b.get<Sprite>().rect[1] = 40;
+	assert(a.read<Sprite>().frame == 1 && b.read<Sprite>().rect[1] == 40 && "Field columns");
+
+	b.del<Sprite>();
+	const Sprite sc = c.read<Sprite>();
+	assert(S::size() == 2 && sc.rect[0] == 5 && sc.scale == 3.f && sc.frame == 3 && "Split delete moves the last one in");
+
+	c.get<Sprite>() = Sprite{{7, 8}, 4.f, 9};
+	assert(S::columns().frame[S::index(c.entity())] == 9 && "Proxy assignment");
+
+	a.destroy();
+	b.destroy();
+	c.destroy();
+	assert(S::size() == 0);
+
+	cout << "Test 13 passed\n";
+}
+
+struct Score { int s; };
+
+void test14() {
+	Entity a = Entity::create();
+	Entity b = Entity::create();
+	Entity c = Entity::create();
+	a.addAll(Vel{1}, Score{1});
+	b.addAll(Vel{2}, Acc{2}, Score{2});
+	c.add(Acc{3});
+
+	int sum = 0, visits = 0;
+	World::each<Vel, Acc, Score>([&](ent_type e) {
+		sum += World::getComponent<Vel>(e).v;
+		++visits;
+	});
+	assert(visits == 1 && sum == 2 && "Packed join");
+
+	visits = 0;
+	World::each<Score>([&](ent_type) { ++visits; });
+	assert(visits == 2 && "Join without a packed pool");
+
+	a.destroy();
+	b.destroy();
+	c.destroy();
+
+	cout << "Test 14 passed\n";
+}
+
+void test15() {
+	World::clear<Vel, Acc, Health, Pos, Flags, Sprite>();
+	std::vector<Entity> es;
+	for (int i = 0; i < 6; ++i)
+		es.push_back(Entity::create());
+	es[0].add(Health{0});
+	es[1].addAll(Vel{1}, Pos{1});
+	es[2].add(Flags{true, false, true});
+	es[3].add(Sprite{{3, 3}, 3.f, 3});
+	es[4].addAll(Health{4}, Vel{4});
+	es[5].add(Pos{5});
+	es[0].destroy();
+	es[3].destroy();
+
+	Remap remap;
+	World::compact<Vel, Acc, Health, Pos, Flags, Sprite>(remap);
+	assert(World::maxId().id == 3 && remap(es[0].entity()).id == -1 && remap(es[4].entity()).id == 2 && "Ids renumbered densely");
+
+	const Entity a{{0}}, b{{1}}, c{{2}}, d{{3}};
+	assert(a.get<Vel>().v == 1 && a.get<Pos>().x == 1 && b.read<Flags>().c && !a.has<Health>() && "Components follow their entity");
+	assert(c.get<Health>().hp == 4 && c.get<Vel>().v == 4 && d.get<Pos>().x == 5 && !d.has<Flags>());
+	assert(BitPackedStorage<Flags>::count(&Flags::a) == 1 && PackedStorage<Vel>::entity(PackedStorage<Vel>::index(c.entity())).id == 2);
+	assert(Entity::create().entity().id == 4 && "New ids continue after the compacted range");
+
+	cout << "Test 15 passed\n";
+}
+
+void test16() {
+	Entity freed = Entity::create();
+	freed.destroy();
+	const id_type first = World::maxId().id + 1;
+
+	constexpr int Threads = 4, PerThread = 100;
+	std::vector<ent_type> made[Threads];
+	{
+		IdCache caches[Threads];
+		World::beginConcurrent();
+		std::vector<std::thread> workers;
+		for (int t = 0; t < Threads; ++t)
+			workers.emplace_back([&, t] {
+				for (int i = 0; i < PerThread; ++i)
+					made[t].push_back(caches[t].create());
+				caches[t].destroy(made[t].back());
+				made[t].pop_back();
+			});
+		for (auto& w : workers)
+			w.join();
+		World::endConcurrent();
+	}
+
+	std::vector<bool> seen(World::maxId().id + 1);
+	for (auto& ids : made)
+		for (ent_type e : ids) {
+			assert(e.id <= World::maxId().id && !seen[e.id] && World::mask(e).ctz() < 0 && "Concurrent ids are unique and live");
+			assert((e.id >= first || e.id == freed.entity().id) && "Fresh ids come after maxId");
+			seen[e.id] = true;
+		}
+	assert(seen[freed.entity().id] && "Free ids are recycled");
+
+	const Entity e = Entity::create();
+	assert(!seen[e.entity().id] && "Unused ids go back to the world");
+	e.add(Health{1});
+	for (auto& ids : made)
+		for (ent_type id : ids)
+			World::destroyEntity(id);
+	e.destroy();
+
+	cout << "Test 16 passed\n";
+}
+
 void run_tests()
 {
 	test1();
+	test2();
+	test3();
+	test4();
+	test5();
+	test6();
+	test7();
+	test8();
+	test9();
+	test10();
+	test11();
+	test12();
+	test13();
+	test14();
+	test15();
+	test16();
 }